@@ -0,0 +1,13 @@
+using System.IO;
+using UnrealBuildTool;
+
+// header only ActorX format core, shared with the standalone tools built by CMakeLists.txt
+public class ActorXCore : ModuleRules
+{
+	public ActorXCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		Type = ModuleType.External;
+		
+		PublicSystemIncludePaths.Add(Path.Combine(ModuleDirectory, "include"));
+	}
+}
@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include "ActorXReader.h"
+#include <vector>
+
+/*
+ * Decodes whole files into owned, naturally laid out arrays. The engine reader views chunks in place instead; this is
+ * what standalone tools and the benchmarks use.
+ */
+namespace ActorX
+{
+	struct MeshData
+	{
+		std::vector<Vector3> Points;
+		std::vector<Wedge> Wedges;
+		std::vector<Face> Faces;
+		std::vector<Material> Materials;
+		std::vector<Vector3> Normals;
+		std::vector<WedgeTangent> Tangents;
+		std::vector<Color> VertexColors;
+		std::vector<std::vector<Vector2>> ExtraUVs;
+		std::vector<NamedBone> Bones;
+		std::vector<RawBoneInfluence> Influences;
+		std::vector<MorphInfo> MorphInfos;
+		std::vector<MorphData> MorphDatas;
+	};
+
+	struct AnimData
+	{
+		std::vector<NamedBone> Bones;
+		std::vector<AnimInfo> AnimInfos;
+		std::vector<QuatAnimKey> Keys;
+		std::vector<ScaleAnimKey> ScaleKeys;
+	};
+
+	template <typename T>
+	bool DecodeElements(const ChunkEntry& Chunk, std::vector<T>& Out)
+	{
+		if (Chunk.Header.DataSize != static_cast<int32_t>(sizeof(T))) return false;
+
+		Out.resize(Chunk.Header.DataCount);
+		std::memcpy(Out.data(), Chunk.Data, Chunk.GetDataSize());
+		return true;
+	}
+
+	template <typename T, typename UnpackType>
+	bool DecodePacked(const ChunkEntry& Chunk, const int32_t PackedSize, std::vector<T>& Out, UnpackType&& Unpack)
+	{
+		if (Chunk.Header.DataSize != PackedSize) return false;
+
+		Out.resize(Chunk.Header.DataCount);
+		for (auto i = 0; i < Chunk.Header.DataCount; i++)
+		{
+			Unpack(Chunk.Data + static_cast<uint64_t>(i) * PackedSize, Out[i]);
+		}
+		return true;
+	}
+
+	inline bool DecodeWedges(const ChunkEntry& Chunk, std::vector<Wedge>& Out)
+	{
+		if (!DecodeElements(Chunk, Out)) return false;
+		if (!HasShortPointIndices(Chunk.Header.DataCount)) return true;
+
+		for (auto& Element : Out)
+		{
+			Element.PointIndex &= 0xFFFF;
+		}
+		return true;
+	}
+
+	// the last chunk of a type wins, except for extra uvs which are one chunk per channel
+	inline bool DecodeChunk(const ChunkEntry& Chunk, MeshData& Mesh)
+	{
+		switch (Chunk.Type)
+		{
+		case ChunkType::Points: return DecodeElements(Chunk, Mesh.Points);
+		case ChunkType::Wedges: return DecodeWedges(Chunk, Mesh.Wedges);
+		case ChunkType::Faces16: return DecodePacked(Chunk, PackedSize::Face16, Mesh.Faces, UnpackFace16<Face>);
+		case ChunkType::Faces32: return DecodePacked(Chunk, PackedSize::Face32, Mesh.Faces, UnpackFace32<Face>);
+		case ChunkType::Materials: return DecodeElements(Chunk, Mesh.Materials);
+		case ChunkType::Normals: return DecodeElements(Chunk, Mesh.Normals);
+		case ChunkType::Tangents: return DecodeElements(Chunk, Mesh.Tangents);
+		case ChunkType::VertexColors: return DecodeElements(Chunk, Mesh.VertexColors);
+		case ChunkType::ExtraUVs: Mesh.ExtraUVs.emplace_back(); return DecodeElements(Chunk, Mesh.ExtraUVs.back());
+		case ChunkType::Bones: return DecodeElements(Chunk, Mesh.Bones);
+		case ChunkType::Influences: return DecodeElements(Chunk, Mesh.Influences);
+		case ChunkType::MorphInfos: return DecodeElements(Chunk, Mesh.MorphInfos);
+		case ChunkType::MorphDatas: return DecodeElements(Chunk, Mesh.MorphDatas);
+		default: return true;
+		}
+	}
+
+	inline bool DecodeChunk(const ChunkEntry& Chunk, AnimData& Anim)
+	{
+		switch (Chunk.Type)
+		{
+		case ChunkType::Bones: return DecodeElements(Chunk, Anim.Bones);
+		case ChunkType::AnimInfos: return DecodeElements(Chunk, Anim.AnimInfos);
+		case ChunkType::AnimKeys: return DecodeElements(Chunk, Anim.Keys);
+		case ChunkType::ScaleKeys: return DecodeElements(Chunk, Anim.ScaleKeys);
+		default: return true;
+		}
+	}
+
+	template <typename DataType>
+	ParseResult DecodeFile(const uint8_t* Data, const uint64_t Size, const char* MainChunkName, DataType& Out)
+	{
+		ChunkCursor Cursor(Data, Size);
+		auto Result = Cursor.ReadMainHeader(MainChunkName);
+		if (Result != ParseResult::Ok) return Result;
+
+		ChunkEntry Chunk;
+		while ((Result = Cursor.Next(Chunk)) == ParseResult::Ok)
+		{
+			if (!DecodeChunk(Chunk, Out)) return ParseResult::InvalidHeader;
+		}
+		return Result == ParseResult::End ? ParseResult::Ok : Result;
+	}
+
+	inline ParseResult DecodeMesh(const uint8_t* Data, const uint64_t Size, MeshData& Out)
+	{
+		return DecodeFile(Data, Size, "ACTRHEAD", Out);
+	}
+
+	inline ParseResult DecodeAnim(const uint8_t* Data, const uint64_t Size, AnimData& Out)
+	{
+		return DecodeFile(Data, Size, "ANIMHEAD", Out);
+	}
+}
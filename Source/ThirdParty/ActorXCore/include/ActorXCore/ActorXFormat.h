@@ -0,0 +1,285 @@
+﻿#pragma once
+
+#include <cstdint>
+
+/*
+ * The ActorX .psk/.pskx/.psa on-disk format, free of any engine types so it can be parsed, generated and benchmarked
+ * by plain C++ tools. Every struct here matches its on-disk element byte for byte, except Face which is widened from
+ * the packed 16 or 32 bit FACE chunks.
+ */
+namespace ActorX
+{
+	// FNV-1a over the null terminated part of a chunk id, usable at compile time
+	constexpr uint32_t ChunkHash(const char* ChunkID, const int32_t MaxLength = 20)
+	{
+		uint32_t Hash = 2166136261u;
+		for (auto i = 0; i < MaxLength && ChunkID[i] != '\0'; i++)
+		{
+			Hash = (Hash ^ static_cast<uint8_t>(ChunkID[i])) * 16777619u;
+		}
+		return Hash;
+	}
+
+	struct ChunkHeader
+	{
+		char ChunkID[20];
+		int32_t TypeFlag;
+		int32_t DataSize;
+		int32_t DataCount;
+	};
+
+	struct Vector2
+	{
+		float X, Y;
+	};
+
+	struct Vector3
+	{
+		float X, Y, Z;
+	};
+
+	struct Quat
+	{
+		float X, Y, Z, W;
+	};
+
+	struct Color
+	{
+		uint8_t B, G, R, A;
+	};
+
+	struct Wedge
+	{
+		uint32_t PointIndex;
+		float U, V;
+		uint8_t MatIndex;
+		uint8_t Reserved;
+		int16_t Pad;
+	};
+
+	struct Face
+	{
+		int32_t WedgeIndex[3];
+		uint8_t MatIndex;
+		uint8_t AuxMatIndex;
+		uint32_t SmoothingGroups;
+	};
+
+	// VTXTANGS, one per wedge; the bitangent is cross(normal, tangent) scaled by BinormalSign
+	struct WedgeTangent
+	{
+		Vector3 Tangent;
+		float BinormalSign;
+	};
+
+	struct Material
+	{
+		char MaterialName[64];
+		int32_t TextureIndex;
+		uint32_t PolyFlags;
+		int32_t AuxMaterial;
+		uint32_t AuxFlags;
+		int32_t LodBias;
+		int32_t LodStyle;
+	};
+
+	struct JointPos
+	{
+		Quat Orientation;
+		Vector3 Position;
+		float Length;
+		float XSize;
+		float YSize;
+		float ZSize;
+	};
+
+	struct NamedBone
+	{
+		char Name[64];
+		int32_t Flags;
+		int32_t NumChildren;
+		int32_t ParentIndex;
+		JointPos BonePos;
+	};
+
+	struct RawBoneInfluence
+	{
+		float Weight;
+		int32_t PointIdx;
+		int32_t BoneIdx;
+	};
+
+	struct MorphInfo
+	{
+		char Name[64];
+		int32_t VertexCount;
+	};
+
+	struct MorphData
+	{
+		Vector3 PositionDelta;
+		Vector3 TangentZDelta;
+		int32_t PointIdx;
+	};
+
+	struct AnimInfo
+	{
+		char Name[64];
+		char Group[64];
+		int32_t TotalBones;
+		int32_t RootInclude;
+		int32_t KeyCompressionStyle;
+		int32_t KeyQuotum;
+		float KeyReduction;
+		float TrackTime;
+		float AnimRate;
+		int32_t StartBone;
+		int32_t FirstRawFrame;
+		int32_t NumRawFrames;
+	};
+
+	struct QuatAnimKey
+	{
+		Vector3 Position;
+		Quat Orientation;
+		float Time;
+	};
+
+	struct ScaleAnimKey
+	{
+		Vector3 ScaleVector;
+		float Time;
+	};
+
+	// on-disk element sizes
+	namespace PackedSize
+	{
+		constexpr int32_t Point = 12;
+		constexpr int32_t Wedge = 16;
+		constexpr int32_t Face16 = 3 * sizeof(uint16_t) + 2 * sizeof(uint8_t) + sizeof(uint32_t);
+		constexpr int32_t Face32 = 3 * sizeof(int32_t) + 2 * sizeof(uint8_t) + sizeof(uint32_t);
+		constexpr int32_t Material = 88;
+		constexpr int32_t Normal = 12;
+		constexpr int32_t Tangent = 16;
+		constexpr int32_t Color = 4;
+		constexpr int32_t UV = 8;
+		constexpr int32_t Bone = 120;
+		constexpr int32_t Influence = 12;
+		constexpr int32_t MorphInfo = 68;
+		constexpr int32_t MorphData = 28;
+		constexpr int32_t AnimInfo = 168;
+		constexpr int32_t AnimKey = 32;
+		constexpr int32_t ScaleKey = 16;
+	}
+
+	static_assert(sizeof(ChunkHeader) == 32, "ChunkHeader must match the on-disk layout");
+	static_assert(sizeof(Wedge) == PackedSize::Wedge, "Wedge must match the on-disk layout");
+	static_assert(sizeof(WedgeTangent) == PackedSize::Tangent, "WedgeTangent must match the on-disk layout");
+	static_assert(sizeof(Material) == PackedSize::Material, "Material must match the on-disk layout");
+	static_assert(sizeof(NamedBone) == PackedSize::Bone, "NamedBone must match the on-disk layout");
+	static_assert(sizeof(MorphInfo) == PackedSize::MorphInfo, "MorphInfo must match the on-disk layout");
+	static_assert(sizeof(MorphData) == PackedSize::MorphData, "MorphData must match the on-disk layout");
+	static_assert(sizeof(AnimInfo) == PackedSize::AnimInfo, "AnimInfo must match the on-disk layout");
+	static_assert(sizeof(QuatAnimKey) == PackedSize::AnimKey, "QuatAnimKey must match the on-disk layout");
+	static_assert(sizeof(ScaleAnimKey) == PackedSize::ScaleKey, "ScaleAnimKey must match the on-disk layout");
+
+	// wedge chunks of up to this many wedges store a 16 bit point index followed by padding
+	constexpr int32_t MaxShortIndexWedges = 65536;
+
+	enum class ChunkType : uint8_t
+	{
+		Points,
+		Wedges,
+		Faces16,
+		Faces32,
+		Materials,
+		Normals,
+		Tangents,
+		VertexColors,
+		ExtraUVs,
+		Bones,
+		Influences,
+		MorphInfos,
+		MorphDatas,
+		AnimInfos,
+		AnimKeys,
+		ScaleKeys,
+		Unknown
+	};
+
+	constexpr ChunkType GetChunkType(const uint32_t Hash)
+	{
+		switch (Hash)
+		{
+		case ChunkHash("PNTS0000"): return ChunkType::Points;
+		case ChunkHash("VTXW0000"): return ChunkType::Wedges;
+		case ChunkHash("FACE0000"): return ChunkType::Faces16;
+		case ChunkHash("FACE3200"): return ChunkType::Faces32;
+		case ChunkHash("MATT0000"): return ChunkType::Materials;
+		case ChunkHash("VTXNORMS"): return ChunkType::Normals;
+		case ChunkHash("VTXTANGS"): return ChunkType::Tangents;
+		case ChunkHash("VERTEXCOLOR"): return ChunkType::VertexColors;
+		case ChunkHash("EXTRAUVS"): return ChunkType::ExtraUVs;
+		// the psa BONENAMES chunk shares the REFSKELT layout
+		case ChunkHash("REFSKELT"):
+		case ChunkHash("REFSKEL0"):
+		case ChunkHash("BONENAMES"): return ChunkType::Bones;
+		case ChunkHash("RAWWEIGHTS"):
+		case ChunkHash("RAWW0000"): return ChunkType::Influences;
+		case ChunkHash("MRPHINFO"): return ChunkType::MorphInfos;
+		case ChunkHash("MRPHDATA"): return ChunkType::MorphDatas;
+		case ChunkHash("ANIMINFO"): return ChunkType::AnimInfos;
+		case ChunkHash("ANIMKEYS"): return ChunkType::AnimKeys;
+		case ChunkHash("SCALEKEYS"): return ChunkType::ScaleKeys;
+		default: return ChunkType::Unknown;
+		}
+	}
+
+	constexpr int32_t GetPackedSize(const ChunkType Type)
+	{
+		switch (Type)
+		{
+		case ChunkType::Points: return PackedSize::Point;
+		case ChunkType::Wedges: return PackedSize::Wedge;
+		case ChunkType::Faces16: return PackedSize::Face16;
+		case ChunkType::Faces32: return PackedSize::Face32;
+		case ChunkType::Materials: return PackedSize::Material;
+		case ChunkType::Normals: return PackedSize::Normal;
+		case ChunkType::Tangents: return PackedSize::Tangent;
+		case ChunkType::VertexColors: return PackedSize::Color;
+		case ChunkType::ExtraUVs: return PackedSize::UV;
+		case ChunkType::Bones: return PackedSize::Bone;
+		case ChunkType::Influences: return PackedSize::Influence;
+		case ChunkType::MorphInfos: return PackedSize::MorphInfo;
+		case ChunkType::MorphDatas: return PackedSize::MorphData;
+		case ChunkType::AnimInfos: return PackedSize::AnimInfo;
+		case ChunkType::AnimKeys: return PackedSize::AnimKey;
+		case ChunkType::ScaleKeys: return PackedSize::ScaleKey;
+		default: return -1;
+		}
+	}
+
+	constexpr const char* GetChunkTypeName(const ChunkType Type)
+	{
+		switch (Type)
+		{
+		case ChunkType::Points: return "Points";
+		case ChunkType::Wedges: return "Wedges";
+		case ChunkType::Faces16: return "Faces16";
+		case ChunkType::Faces32: return "Faces32";
+		case ChunkType::Materials: return "Materials";
+		case ChunkType::Normals: return "Normals";
+		case ChunkType::Tangents: return "Tangents";
+		case ChunkType::VertexColors: return "VertexColors";
+		case ChunkType::ExtraUVs: return "ExtraUVs";
+		case ChunkType::Bones: return "Bones";
+		case ChunkType::Influences: return "Influences";
+		case ChunkType::MorphInfos: return "MorphInfos";
+		case ChunkType::MorphDatas: return "MorphDatas";
+		case ChunkType::AnimInfos: return "AnimInfos";
+		case ChunkType::AnimKeys: return "AnimKeys";
+		case ChunkType::ScaleKeys: return "ScaleKeys";
+		default: return "Unknown";
+		}
+	}
+}
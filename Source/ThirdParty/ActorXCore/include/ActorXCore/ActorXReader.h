@@ -0,0 +1,157 @@
+﻿#pragma once
+
+#include "ActorXFormat.h"
+#include <cstring>
+
+namespace ActorX
+{
+	enum class ParseResult : uint8_t
+	{
+		Ok,
+		End,
+		TooSmall,
+		WrongMainChunk,
+		InvalidHeader,
+		Truncated,
+		// only reported by file based readers
+		CannotOpen
+	};
+
+	struct ChunkEntry
+	{
+		ChunkHeader Header;
+		uint32_t Hash;
+		ChunkType Type;
+		const uint8_t* Data;
+
+		uint64_t GetDataSize() const
+		{
+			return static_cast<uint64_t>(Header.DataSize) * static_cast<uint64_t>(Header.DataCount);
+		}
+	};
+
+	/*
+	 * Walks the chunk headers of an ActorX file held in memory. Chunk data is never touched, every chunk is bounds
+	 * checked against the end of the file before it is handed out.
+	 */
+	class ChunkCursor
+	{
+	public:
+		ChunkCursor(const uint8_t* InData, const uint64_t InSize) : Data(InData), Size(InSize)
+		{
+		}
+
+		ParseResult ReadMainHeader(const char* MainChunkName)
+		{
+			if (Size < sizeof(ChunkHeader)) return ParseResult::TooSmall;
+
+			ChunkHeader Header;
+			std::memcpy(&Header, Data, sizeof(ChunkHeader));
+			if (ChunkHash(Header.ChunkID) != ChunkHash(MainChunkName)) return ParseResult::WrongMainChunk;
+
+			Offset = sizeof(ChunkHeader);
+			return ParseResult::Ok;
+		}
+
+		// OutChunk.Header is filled in for anything but End, so callers can report which chunk was broken
+		ParseResult Next(ChunkEntry& OutChunk)
+		{
+			if (Offset + sizeof(ChunkHeader) > Size) return ParseResult::End;
+
+			std::memcpy(&OutChunk.Header, Data + Offset, sizeof(ChunkHeader));
+			Offset += sizeof(ChunkHeader);
+
+			OutChunk.Hash = ChunkHash(OutChunk.Header.ChunkID);
+			OutChunk.Type = GetChunkType(OutChunk.Hash);
+			OutChunk.Data = Data + Offset;
+
+			if (OutChunk.Header.DataSize < 0 || OutChunk.Header.DataCount < 0) return ParseResult::InvalidHeader;
+			if (OutChunk.GetDataSize() > Size - Offset) return ParseResult::Truncated;
+
+			Offset += OutChunk.GetDataSize();
+			return ParseResult::Ok;
+		}
+
+		uint64_t GetOffset() const { return Offset; }
+
+	private:
+		const uint8_t* Data;
+		uint64_t Size;
+		uint64_t Offset = 0;
+	};
+
+	/*
+	 * Unpacking of elements whose on-disk layout differs from a natural struct layout. These only rely on the field
+	 * names, so they fill both the structs in ActorXFormat.h and engine side structs with the same fields.
+	 */
+	template <typename FaceType>
+	void UnpackFace16(const uint8_t* Packed, FaceType& Face)
+	{
+		uint16_t WedgeIndices[3];
+		std::memcpy(WedgeIndices, Packed, sizeof WedgeIndices);
+		for (auto j = 0; j < 3; j++)
+		{
+			Face.WedgeIndex[j] = WedgeIndices[j];
+		}
+
+		Face.MatIndex = Packed[6];
+		Face.AuxMatIndex = Packed[7];
+		std::memcpy(&Face.SmoothingGroups, Packed + 8, sizeof(uint32_t));
+	}
+
+	template <typename FaceType>
+	void UnpackFace32(const uint8_t* Packed, FaceType& Face)
+	{
+		std::memcpy(&Face.WedgeIndex, Packed, 3 * sizeof(int32_t));
+		Face.MatIndex = Packed[12];
+		Face.AuxMatIndex = Packed[13];
+		std::memcpy(&Face.SmoothingGroups, Packed + 14, sizeof(uint32_t));
+	}
+
+	template <typename BoneType>
+	void UnpackBone(const uint8_t* Packed, BoneType& Bone)
+	{
+		auto ReadField = [&Packed](void* Field, const size_t FieldSize)
+		{
+			std::memcpy(Field, Packed, FieldSize);
+			Packed += FieldSize;
+		};
+
+		ReadField(&Bone.Name, 64);
+		ReadField(&Bone.Flags, sizeof(int32_t));
+		ReadField(&Bone.NumChildren, sizeof(int32_t));
+		ReadField(&Bone.ParentIndex, sizeof(int32_t));
+		ReadField(&Bone.BonePos.Orientation, 4 * sizeof(float));
+		ReadField(&Bone.BonePos.Position, 3 * sizeof(float));
+		ReadField(&Bone.BonePos.Length, sizeof(float));
+		ReadField(&Bone.BonePos.XSize, sizeof(float));
+		ReadField(&Bone.BonePos.YSize, sizeof(float));
+		ReadField(&Bone.BonePos.ZSize, sizeof(float));
+	}
+
+	template <typename KeyType>
+	void UnpackAnimKey(const uint8_t* Packed, KeyType& Key)
+	{
+		std::memcpy(&Key.Position, Packed, 3 * sizeof(float));
+		std::memcpy(&Key.Orientation, Packed + 12, 4 * sizeof(float));
+		std::memcpy(&Key.Time, Packed + 28, sizeof(float));
+	}
+
+	template <typename KeyType>
+	void UnpackScaleKey(const uint8_t* Packed, KeyType& Key)
+	{
+		std::memcpy(&Key.ScaleVector, Packed, 3 * sizeof(float));
+		std::memcpy(&Key.Time, Packed + 12, sizeof(float));
+	}
+
+	inline bool HasShortPointIndices(const int32_t WedgeCount)
+	{
+		return WedgeCount <= MaxShortIndexWedges;
+	}
+
+	// keys are stored frame by frame, with every bone of the sequence on each frame
+	inline int64_t GetAnimKeyIndex(const int32_t FirstRawFrame, const int32_t TotalBones, const int32_t Frame, const int32_t BoneIndex)
+	{
+		return (static_cast<int64_t>(FirstRawFrame) + Frame) * TotalBones + BoneIndex;
+	}
+}
@@ -0,0 +1,297 @@
+﻿#pragma once
+
+#include "ActorXReader.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * Summarizes an ActorX file from its chunk headers without loading it. Only the main header, one header per chunk and
+ * the small name chunks (materials, bones, sequences and morph targets) are read, everything else is skipped with a
+ * seek. Every chunk is checked against the end of the file and against the element size of its type.
+ */
+namespace ActorX
+{
+	// name chunks larger than this are counted but not read
+	constexpr uint64_t MaxScannedNameChunkSize = 16 * 1024 * 1024;
+
+	struct ScannedChunk
+	{
+		std::string Name;
+		ChunkType Type;
+		int32_t DataSize;
+		int32_t DataCount;
+		uint64_t Offset;
+	};
+
+	struct FileSummary
+	{
+		std::string Filename;
+		uint64_t FileSize = 0;
+		bool bIsAnimation = false;
+		ParseResult Result = ParseResult::Ok;
+		// the first problem found, empty for valid files
+		std::string Problem;
+		std::vector<ScannedChunk> Chunks;
+
+		int64_t Points = 0;
+		int64_t Wedges = 0;
+		int64_t Faces = 0;
+		int64_t Bones = 0;
+		int64_t Influences = 0;
+		int32_t UVChannels = 0;
+		int64_t AnimKeys = 0;
+		std::vector<std::string> MaterialNames;
+		std::vector<std::string> MorphTargetNames;
+		std::vector<std::string> SequenceNames;
+
+		bool IsValid() const { return Result == ParseResult::Ok && Problem.empty(); }
+		
+		bool HasChunk(const ChunkType Type) const
+		{
+			for (const auto& Chunk : Chunks)
+			{
+				if (Chunk.Type == Type) return true;
+			}
+			return false;
+		}
+	};
+
+	constexpr const char* GetParseResultName(const ParseResult Result)
+	{
+		switch (Result)
+		{
+		case ParseResult::Ok: return "Ok";
+		case ParseResult::End: return "End";
+		case ParseResult::TooSmall: return "TooSmall";
+		case ParseResult::WrongMainChunk: return "WrongMainChunk";
+		case ParseResult::InvalidHeader: return "InvalidHeader";
+		case ParseResult::Truncated: return "Truncated";
+		case ParseResult::CannotOpen: return "CannotOpen";
+		default: return "Unknown";
+		}
+	}
+
+	inline std::string GetFixedString(const char* Chars, const size_t MaxLength)
+	{
+		size_t Length = 0;
+		while (Length < MaxLength && Chars[Length] != '\0') Length++;
+		return std::string(Chars, Length);
+	}
+
+	inline bool SeekFile(std::FILE* File, const uint64_t Offset)
+	{
+#if defined(_WIN32)
+		return _fseeki64(File, static_cast<int64_t>(Offset), SEEK_SET) == 0;
+#else
+		return fseeko(File, static_cast<off_t>(Offset), SEEK_SET) == 0;
+#endif
+	}
+
+	inline uint64_t GetFileSize(std::FILE* File)
+	{
+#if defined(_WIN32)
+		_fseeki64(File, 0, SEEK_END);
+		const auto Size = _ftelli64(File);
+#else
+		fseeko(File, 0, SEEK_END);
+		const auto Size = ftello(File);
+#endif
+		return Size > 0 ? static_cast<uint64_t>(Size) : 0;
+	}
+
+	template <typename T>
+	bool ReadChunkElements(std::FILE* File, const ScannedChunk& Chunk, std::vector<T>& Out)
+	{
+		Out.resize(Chunk.DataCount);
+		return SeekFile(File, Chunk.Offset) && std::fread(Out.data(), sizeof(T), Out.size(), File) == Out.size();
+	}
+
+	// the checks that only need headers and name chunks: counts that must agree and sequences that must fit ANIMKEYS
+	inline void ValidateSummary(FileSummary& Summary, const std::vector<AnimInfo>& AnimInfos)
+	{
+		auto Fail = [&Summary](const std::string& Problem)
+		{
+			if (Summary.Problem.empty()) Summary.Problem = Problem;
+		};
+
+		if (Summary.bIsAnimation)
+		{
+			if (!Summary.HasChunk(ChunkType::Bones)) Fail("missing BONENAMES");
+			if (!Summary.HasChunk(ChunkType::AnimInfos)) Fail("missing ANIMINFO");
+			if (!Summary.HasChunk(ChunkType::AnimKeys)) Fail("missing ANIMKEYS");
+			for (const auto& Info : AnimInfos)
+			{
+				const auto Name = GetFixedString(Info.Name, sizeof Info.Name);
+				if (Info.TotalBones < 0 || Info.FirstRawFrame < 0 || Info.NumRawFrames < 0) Fail(Name + " has negative counts");
+				else if (Info.TotalBones > Summary.Bones) Fail(Name + " uses more bones than BONENAMES holds");
+				else if (GetAnimKeyIndex(Info.FirstRawFrame, Info.TotalBones, Info.NumRawFrames, 0) > Summary.AnimKeys) Fail(Name + " runs past the end of ANIMKEYS");
+			}
+			return;
+		}
+
+		if (!Summary.HasChunk(ChunkType::Points)) Fail("missing PNTS0000");
+		if (!Summary.HasChunk(ChunkType::Wedges)) Fail("missing VTXW0000");
+		if (!Summary.HasChunk(ChunkType::Faces16) && !Summary.HasChunk(ChunkType::Faces32)) Fail("missing FACE0000 or FACE3200");
+		if (!Summary.HasChunk(ChunkType::Materials)) Fail("missing MATT0000");
+		for (const auto& Chunk : Summary.Chunks)
+		{
+			const auto bPerWedge = Chunk.Type == ChunkType::VertexColors || Chunk.Type == ChunkType::ExtraUVs || Chunk.Type == ChunkType::Tangents;
+			if (bPerWedge && Chunk.DataCount != Summary.Wedges) Fail(Chunk.Name + " does not have one element per wedge");
+			if (Chunk.Type == ChunkType::Normals && Chunk.DataCount != Summary.Points) Fail(Chunk.Name + " does not have one element per point");
+		}
+	}
+
+	inline FileSummary ScanFile(const std::string& Filename)
+	{
+		FileSummary Summary;
+		Summary.Filename = Filename;
+		
+		const auto File = std::fopen(Filename.c_str(), "rb");
+		if (File == nullptr)
+		{
+			Summary.Result = ParseResult::CannotOpen;
+			Summary.Problem = "cannot be opened";
+			return Summary;
+		}
+		
+		Summary.FileSize = GetFileSize(File);
+		SeekFile(File, 0);
+
+		ChunkHeader Header;
+		if (Summary.FileSize < sizeof(ChunkHeader) || std::fread(&Header, sizeof Header, 1, File) != 1)
+		{
+			std::fclose(File);
+			Summary.Result = ParseResult::TooSmall;
+			Summary.Problem = "smaller than a chunk header";
+			return Summary;
+		}
+
+		const auto MainHash = ChunkHash(Header.ChunkID);
+		Summary.bIsAnimation = MainHash == ChunkHash("ANIMHEAD");
+		if (!Summary.bIsAnimation && MainHash != ChunkHash("ACTRHEAD"))
+		{
+			std::fclose(File);
+			Summary.Result = ParseResult::WrongMainChunk;
+			Summary.Problem = "not an ActorX file";
+			return Summary;
+		}
+
+		std::vector<AnimInfo> AnimInfos;
+		auto Offset = static_cast<uint64_t>(sizeof(ChunkHeader));
+		while (Offset + sizeof(ChunkHeader) <= Summary.FileSize)
+		{
+			if (!SeekFile(File, Offset) || std::fread(&Header, sizeof Header, 1, File) != 1)
+			{
+				Summary.Result = ParseResult::Truncated;
+				Summary.Problem = "read failed";
+				break;
+			}
+			Offset += sizeof(ChunkHeader);
+
+			ScannedChunk Chunk { GetFixedString(Header.ChunkID, sizeof Header.ChunkID), GetChunkType(ChunkHash(Header.ChunkID)), Header.DataSize, Header.DataCount, Offset };
+			if (Header.DataSize < 0 || Header.DataCount < 0)
+			{
+				Summary.Result = ParseResult::InvalidHeader;
+				Summary.Problem = Chunk.Name + " has a negative size";
+				break;
+			}
+
+			const auto DataSize = static_cast<uint64_t>(Header.DataSize) * static_cast<uint64_t>(Header.DataCount);
+			if (DataSize > Summary.FileSize - Offset)
+			{
+				Summary.Result = ParseResult::Truncated;
+				Summary.Problem = Chunk.Name + " runs past the end of the file";
+				break;
+			}
+			
+			if (Chunk.Type != ChunkType::Unknown && Header.DataCount > 0 && Header.DataSize != GetPackedSize(Chunk.Type))
+			{
+				Summary.Result = ParseResult::InvalidHeader;
+				Summary.Problem = Chunk.Name + " has element size " + std::to_string(Header.DataSize) + ", expected " + std::to_string(GetPackedSize(Chunk.Type));
+				break;
+			}
+			
+			Offset += DataSize;
+			Summary.Chunks.push_back(Chunk);
+
+			const auto bReadNames = DataSize <= MaxScannedNameChunkSize;
+			switch (Chunk.Type)
+			{
+			case ChunkType::Points: Summary.Points = Chunk.DataCount; break;
+			case ChunkType::Wedges: Summary.Wedges = Chunk.DataCount; break;
+			case ChunkType::Faces16:
+			case ChunkType::Faces32: Summary.Faces = Chunk.DataCount; break;
+			case ChunkType::Bones:
+				{
+					Summary.Bones = Chunk.DataCount;
+					
+					std::vector<NamedBone> Bones;
+					if (!bReadNames || !ReadChunkElements(File, Chunk, Bones)) break;
+
+					// roots point at themselves or at -1, any other parent has to be one of the bones
+					for (const auto& Bone : Bones)
+					{
+						if ((Bone.ParentIndex < -1 || Bone.ParentIndex >= Chunk.DataCount) && Summary.Problem.empty())
+						{
+							Summary.Problem = GetFixedString(Bone.Name, sizeof Bone.Name) + " has parent " + std::to_string(Bone.ParentIndex) + " outside of the skeleton";
+						}
+					}
+					break;
+				}
+			case ChunkType::Influences: Summary.Influences = Chunk.DataCount; break;
+			case ChunkType::ExtraUVs: Summary.UVChannels++; break;
+			case ChunkType::AnimKeys: Summary.AnimKeys = Chunk.DataCount; break;
+			case ChunkType::Materials:
+				{
+					std::vector<Material> Materials;
+					if (!bReadNames || !ReadChunkElements(File, Chunk, Materials)) break;
+
+					Summary.MaterialNames.clear();
+					for (const auto& Material : Materials)
+					{
+						Summary.MaterialNames.push_back(GetFixedString(Material.MaterialName, sizeof Material.MaterialName));
+					}
+					break;
+				}
+			case ChunkType::MorphInfos:
+				{
+					std::vector<MorphInfo> MorphInfos;
+					if (!bReadNames || !ReadChunkElements(File, Chunk, MorphInfos)) break;
+
+					Summary.MorphTargetNames.clear();
+					for (const auto& Info : MorphInfos)
+					{
+						Summary.MorphTargetNames.push_back(GetFixedString(Info.Name, sizeof Info.Name));
+					}
+					break;
+				}
+			case ChunkType::AnimInfos:
+				{
+					if (!bReadNames || !ReadChunkElements(File, Chunk, AnimInfos)) break;
+
+					Summary.SequenceNames.clear();
+					for (const auto& Info : AnimInfos)
+					{
+						Summary.SequenceNames.push_back(GetFixedString(Info.Name, sizeof Info.Name));
+					}
+					break;
+				}
+			default: break;
+			}
+		}
+		std::fclose(File);
+
+		if (Summary.Result == ParseResult::Ok && Offset != Summary.FileSize)
+		{
+			Summary.Problem = std::to_string(Summary.FileSize - Offset) + " trailing bytes after the last chunk";
+		}
+		if (Summary.Result == ParseResult::Ok)
+		{
+			if (!Summary.bIsAnimation && Summary.Wedges > 0) Summary.UVChannels++;
+			ValidateSummary(Summary, AnimInfos);
+		}
+		
+		return Summary;
+	}
+}
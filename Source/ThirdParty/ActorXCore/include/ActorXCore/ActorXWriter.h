@@ -0,0 +1,119 @@
+﻿#pragma once
+
+#include "ActorXFormat.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace ActorX
+{
+	// the version ActorX writes into every chunk header
+	constexpr int32_t ChunkTypeFlag = 20100422;
+
+	template <typename FaceType>
+	void PackFace16(const FaceType& Face, uint8_t* Packed)
+	{
+		for (auto j = 0; j < 3; j++)
+		{
+			const auto WedgeIndex = static_cast<uint16_t>(Face.WedgeIndex[j]);
+			std::memcpy(Packed + j * sizeof(uint16_t), &WedgeIndex, sizeof(uint16_t));
+		}
+
+		Packed[6] = static_cast<uint8_t>(Face.MatIndex);
+		Packed[7] = static_cast<uint8_t>(Face.AuxMatIndex);
+		std::memcpy(Packed + 8, &Face.SmoothingGroups, sizeof(uint32_t));
+	}
+
+	template <typename FaceType>
+	void PackFace32(const FaceType& Face, uint8_t* Packed)
+	{
+		for (auto j = 0; j < 3; j++)
+		{
+			const auto WedgeIndex = static_cast<int32_t>(Face.WedgeIndex[j]);
+			std::memcpy(Packed + j * sizeof(int32_t), &WedgeIndex, sizeof(int32_t));
+		}
+
+		Packed[12] = static_cast<uint8_t>(Face.MatIndex);
+		Packed[13] = static_cast<uint8_t>(Face.AuxMatIndex);
+		std::memcpy(Packed + 14, &Face.SmoothingGroups, sizeof(uint32_t));
+	}
+
+	/*
+	 * Builds an ActorX file in memory. Every chunk is written as one header followed by one block of element data.
+	 */
+	class ChunkWriter
+	{
+	public:
+		explicit ChunkWriter(const char* MainChunkName)
+		{
+			WriteHeader(MainChunkName, 0, 0);
+		}
+
+		void WriteHeader(const char* ChunkName, const int32_t DataSize, const int32_t DataCount)
+		{
+			ChunkHeader Header{};
+			std::strncpy(Header.ChunkID, ChunkName, sizeof Header.ChunkID);
+			Header.TypeFlag = ChunkTypeFlag;
+			Header.DataSize = DataSize;
+			Header.DataCount = DataCount;
+			Append(&Header, sizeof Header);
+		}
+
+		void WriteChunk(const char* ChunkName, const void* Elements, const int32_t DataSize, const int32_t DataCount)
+		{
+			WriteHeader(ChunkName, DataSize, DataCount);
+			Append(Elements, static_cast<size_t>(DataSize) * DataCount);
+		}
+
+		template <typename T>
+		void WriteChunk(const char* ChunkName, const std::vector<T>& Elements)
+		{
+			WriteChunk(ChunkName, Elements.data(), sizeof(T), static_cast<int32_t>(Elements.size()));
+		}
+
+		// picks the 16 bit layout whenever every wedge index fits
+		template <typename FaceType>
+		void WriteFaces(const FaceType* Faces, const int32_t Count, const int32_t WedgeCount)
+		{
+			const auto bShortIndices = WedgeCount <= MaxShortIndexWedges;
+			const auto PackedFaceSize = bShortIndices ? PackedSize::Face16 : PackedSize::Face32;
+			WriteHeader(bShortIndices ? "FACE0000" : "FACE3200", PackedFaceSize, Count);
+
+			const auto Start = Buffer.size();
+			Buffer.resize(Start + static_cast<size_t>(PackedFaceSize) * Count);
+			auto Packed = Buffer.data() + Start;
+			for (auto i = 0; i < Count; i++, Packed += PackedFaceSize)
+			{
+				if (bShortIndices)
+				{
+					PackFace16(Faces[i], Packed);
+				}
+				else
+				{
+					PackFace32(Faces[i], Packed);
+				}
+			}
+		}
+
+		const std::vector<uint8_t>& GetBuffer() const { return Buffer; }
+		std::vector<uint8_t>& GetBuffer() { return Buffer; }
+
+		bool SaveToFile(const char* Filename) const
+		{
+			const auto File = std::fopen(Filename, "wb");
+			if (File == nullptr) return false;
+
+			const auto Written = std::fwrite(Buffer.data(), 1, Buffer.size(), File);
+			return std::fclose(File) == 0 && Written == Buffer.size();
+		}
+
+	private:
+		void Append(const void* Data, const size_t Size)
+		{
+			const auto Bytes = static_cast<const uint8_t*>(Data);
+			Buffer.insert(Buffer.end(), Bytes, Bytes + Size);
+		}
+
+		std::vector<uint8_t> Buffer;
+	};
+}
@@ -0,0 +1,229 @@
+﻿#include "ActorXSynthetic.h"
+#include "ActorXCore/ActorXDecode.h"
+#include <chrono>
+#include <cstdlib>
+#include <map>
+
+/*
+ * Measures chunk directory parsing and per chunk type decoding throughput.
+ *
+ * ActorXBench [--triangles N]... [--anim] [--repeat N] [--csv] [File.psk|File.pskx|File.psa]...
+ *
+ * Without inputs it benchmarks synthetic meshes of 1K, 10K, 100K and 1M triangles and one synthetic animation.
+ * Every measurement is the best of --repeat rounds, each round running long enough to be above timer resolution.
+ */
+
+using namespace ActorX;
+
+struct BenchInput
+{
+	std::string Label;
+	std::vector<uint8_t> Data;
+};
+
+struct BenchRow
+{
+	std::string Input;
+	std::string Stage;
+	uint64_t Bytes = 0;
+	uint64_t Elements = 0;
+	double Seconds = 0.0;
+};
+
+template <typename FuncType>
+static double MeasureSeconds(const int32_t Repeat, FuncType&& Func)
+{
+	using Clock = std::chrono::steady_clock;
+	
+	auto Best = 1e30;
+	for (auto Round = 0; Round < Repeat; Round++)
+	{
+		int64_t Iterations = 0;
+		const auto Start = Clock::now();
+		auto Elapsed = 0.0;
+		do
+		{
+			Func();
+			Iterations++;
+			Elapsed = std::chrono::duration<double>(Clock::now() - Start).count();
+		}
+		while (Elapsed < 0.002);
+		
+		Best = std::min(Best, Elapsed / Iterations);
+	}
+	return Best;
+}
+
+static bool LoadFile(const char* Filename, std::vector<uint8_t>& Out)
+{
+	const auto File = std::fopen(Filename, "rb");
+	if (File == nullptr) return false;
+
+	std::fseek(File, 0, SEEK_END);
+	const auto Size = std::ftell(File);
+	std::fseek(File, 0, SEEK_SET);
+	
+	Out.resize(Size > 0 ? Size : 0);
+	const auto Read = std::fread(Out.data(), 1, Out.size(), File);
+	std::fclose(File);
+	return Read == Out.size();
+}
+
+template <typename DataType>
+static void BenchChunks(const BenchInput& Input, const char* MainChunkName, const int32_t Repeat, std::vector<BenchRow>& Rows)
+{
+	auto CountChunks = [&Input, MainChunkName]
+	{
+		ChunkCursor Cursor(Input.Data.data(), Input.Data.size());
+		Cursor.ReadMainHeader(MainChunkName);
+		
+		ChunkEntry Chunk;
+		auto Count = 0;
+		while (Cursor.Next(Chunk) == ParseResult::Ok)
+		{
+			Count++;
+		}
+		return Count;
+	};
+
+	// the directory walk only touches the main header and one header per chunk
+	const auto NumChunks = static_cast<uint64_t>(CountChunks());
+	BenchRow DirectoryRow { Input.Label, "Directory", (NumChunks + 1) * sizeof(ChunkHeader), NumChunks };
+	DirectoryRow.Seconds = MeasureSeconds(Repeat, [&CountChunks]
+	{
+		volatile auto Count = CountChunks();
+		(void)Count;
+	});
+	Rows.push_back(DirectoryRow);
+
+	// chunks of the same type are measured together, extra uvs come as one chunk per channel
+	std::map<ChunkType, std::vector<ChunkEntry>> ChunksByType;
+	ChunkCursor Cursor(Input.Data.data(), Input.Data.size());
+	Cursor.ReadMainHeader(MainChunkName);
+	ChunkEntry Chunk;
+	while (Cursor.Next(Chunk) == ParseResult::Ok)
+	{
+		if (Chunk.Type != ChunkType::Unknown)
+		{
+			ChunksByType[Chunk.Type].push_back(Chunk);
+		}
+	}
+
+	for (const auto& [Type, Chunks] : ChunksByType)
+	{
+		BenchRow Row { Input.Label, GetChunkTypeName(Type) };
+		for (const auto& TypeChunk : Chunks)
+		{
+			Row.Bytes += TypeChunk.GetDataSize();
+			Row.Elements += TypeChunk.Header.DataCount;
+		}
+
+		// every iteration decodes into fresh arrays, the same as an import does
+		DataType Decoded;
+		Row.Seconds = MeasureSeconds(Repeat, [&Decoded, &Chunks]
+		{
+			Decoded = DataType();
+			for (const auto& TypeChunk : Chunks)
+			{
+				DecodeChunk(TypeChunk, Decoded);
+			}
+		});
+		Rows.push_back(Row);
+	}
+
+	DataType Decoded;
+	BenchRow TotalRow { Input.Label, "DecodeFile", Input.Data.size(), 1 };
+	TotalRow.Seconds = MeasureSeconds(Repeat, [&Decoded, &Input, MainChunkName]
+	{
+		Decoded = DataType();
+		DecodeFile(Input.Data.data(), Input.Data.size(), MainChunkName, Decoded);
+	});
+	Rows.push_back(TotalRow);
+}
+
+int main(int Argc, char** Argv)
+{
+	std::vector<int64_t> TriangleCounts;
+	std::vector<std::string> Files;
+	auto bAnim = false;
+	auto bCsv = false;
+	auto Repeat = 5;
+
+	for (auto i = 1; i < Argc; i++)
+	{
+		const std::string Arg = Argv[i];
+		if (Arg == "--triangles" && i + 1 < Argc) TriangleCounts.push_back(std::atoll(Argv[++i]));
+		else if (Arg == "--repeat" && i + 1 < Argc) Repeat = std::max(1, std::atoi(Argv[++i]));
+		else if (Arg == "--anim") bAnim = true;
+		else if (Arg == "--csv") bCsv = true;
+		else if (Arg.rfind("--", 0) == 0)
+		{
+			std::fprintf(stderr, "Usage: %s [--triangles N]... [--anim] [--repeat N] [--csv] [File]...\n", Argv[0]);
+			return 2;
+		}
+		else Files.push_back(Arg);
+	}
+
+	if (TriangleCounts.empty() && Files.empty())
+	{
+		TriangleCounts = { 1000, 10000, 100000, 1000000 };
+		bAnim = true;
+	}
+
+	std::vector<BenchInput> MeshInputs;
+	std::vector<BenchInput> AnimInputs;
+	for (const auto Triangles : TriangleCounts)
+	{
+		Synthetic::MeshOptions Options;
+		Options.Triangles = Triangles;
+		MeshInputs.push_back({ "synthetic_" + std::to_string(Triangles), Synthetic::GenerateMesh(Options) });
+	}
+	if (bAnim)
+	{
+		AnimInputs.push_back({ "synthetic_anim", Synthetic::GenerateAnim(Synthetic::AnimOptions()) });
+	}
+	
+	for (const auto& File : Files)
+	{
+		BenchInput Input;
+		Input.Label = File;
+		if (!LoadFile(File.c_str(), Input.Data))
+		{
+			std::fprintf(stderr, "Failed to read %s\n", File.c_str());
+			return 1;
+		}
+
+		ChunkCursor Cursor(Input.Data.data(), Input.Data.size());
+		(Cursor.ReadMainHeader("ANIMHEAD") == ParseResult::Ok ? AnimInputs : MeshInputs).push_back(std::move(Input));
+	}
+
+	std::vector<BenchRow> Rows;
+	for (const auto& Input : MeshInputs)
+	{
+		BenchChunks<MeshData>(Input, "ACTRHEAD", Repeat, Rows);
+	}
+	for (const auto& Input : AnimInputs)
+	{
+		BenchChunks<AnimData>(Input, "ANIMHEAD", Repeat, Rows);
+	}
+
+	if (bCsv)
+	{
+		std::printf("input,stage,bytes,elements,seconds,mb_per_second,elements_per_second\n");
+	}
+	else
+	{
+		std::printf("%-24s %-14s %12s %12s %12s %12s %16s\n", "Input", "Stage", "Bytes", "Elements", "Seconds", "MB/s", "Elements/s");
+	}
+	
+	for (const auto& Row : Rows)
+	{
+		const auto MegabytesPerSecond = Row.Bytes / (1024.0 * 1024.0) / Row.Seconds;
+		const auto ElementsPerSecond = Row.Elements / Row.Seconds;
+		const auto Format = bCsv ? "%s,%s,%llu,%llu,%.9f,%.2f,%.0f\n" : "%-24s %-14s %12llu %12llu %12.9f %12.2f %16.0f\n";
+		std::printf(Format, Row.Input.c_str(), Row.Stage.c_str(), static_cast<unsigned long long>(Row.Bytes),
+			static_cast<unsigned long long>(Row.Elements), Row.Seconds, MegabytesPerSecond, ElementsPerSecond);
+	}
+
+	return 0;
+}
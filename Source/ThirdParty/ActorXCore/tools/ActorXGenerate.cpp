@@ -0,0 +1,106 @@
+﻿#include "ActorXSynthetic.h"
+#include <cstdlib>
+
+/*
+ * Writes synthetic ActorX files for benchmarking and fuzzing seeds.
+ *
+ * ActorXGenerate mesh <File.psk> <Triangles> [--bones N] [--influences N] [--extra-uvs N] [--morphs N]
+ * ActorXGenerate anim <File.psa> [--bones N] [--sequences N] [--frames N] [--no-scale]
+ * ActorXGenerate suite <Directory>		1K, 10K, 100K, 1M and 10M triangle meshes plus one animation
+ */
+
+using namespace ActorX;
+
+static int32_t ParseOption(int Argc, char** Argv, const char* Name, const int32_t Default)
+{
+	for (auto i = 0; i + 1 < Argc; i++)
+	{
+		if (std::strcmp(Argv[i], Name) == 0) return std::atoi(Argv[i + 1]);
+	}
+	return Default;
+}
+
+static bool HasFlag(int Argc, char** Argv, const char* Name)
+{
+	for (auto i = 0; i < Argc; i++)
+	{
+		if (std::strcmp(Argv[i], Name) == 0) return true;
+	}
+	return false;
+}
+
+static bool Save(const std::vector<uint8_t>& Buffer, const std::string& Filename)
+{
+	const auto File = std::fopen(Filename.c_str(), "wb");
+	if (File == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open %s\n", Filename.c_str());
+		return false;
+	}
+
+	const auto Written = std::fwrite(Buffer.data(), 1, Buffer.size(), File);
+	if (std::fclose(File) != 0 || Written != Buffer.size())
+	{
+		std::fprintf(stderr, "Failed to write %s\n", Filename.c_str());
+		return false;
+	}
+
+	std::printf("%s: %.2f MB\n", Filename.c_str(), Buffer.size() / (1024.0 * 1024.0));
+	return true;
+}
+
+int main(int Argc, char** Argv)
+{
+	if (Argc < 3)
+	{
+		std::fprintf(stderr, "Usage: %s mesh <File.psk> <Triangles> [--bones N] [--influences N] [--extra-uvs N] [--morphs N]\n", Argv[0]);
+		std::fprintf(stderr, "       %s anim <File.psa> [--bones N] [--sequences N] [--frames N] [--no-scale]\n", Argv[0]);
+		std::fprintf(stderr, "       %s suite <Directory>\n", Argv[0]);
+		return 2;
+	}
+
+	const std::string Mode = Argv[1];
+	const std::string Output = Argv[2];
+
+	if (Mode == "mesh" && Argc >= 4)
+	{
+		Synthetic::MeshOptions Options;
+		Options.Triangles = std::atoll(Argv[3]);
+		Options.Bones = ParseOption(Argc, Argv, "--bones", Options.Bones);
+		Options.InfluencesPerPoint = ParseOption(Argc, Argv, "--influences", Options.InfluencesPerPoint);
+		Options.ExtraUVChannels = ParseOption(Argc, Argv, "--extra-uvs", Options.ExtraUVChannels);
+		Options.MorphTargets = ParseOption(Argc, Argv, "--morphs", Options.MorphTargets);
+		if (Options.Triangles <= 0 || Options.Triangles > INT32_MAX)
+		{
+			std::fprintf(stderr, "Triangle count out of range\n");
+			return 2;
+		}
+		return Save(Synthetic::GenerateMesh(Options), Output) ? 0 : 1;
+	}
+
+	if (Mode == "anim")
+	{
+		Synthetic::AnimOptions Options;
+		Options.Bones = ParseOption(Argc, Argv, "--bones", Options.Bones);
+		Options.Sequences = ParseOption(Argc, Argv, "--sequences", Options.Sequences);
+		Options.FramesPerSequence = ParseOption(Argc, Argv, "--frames", Options.FramesPerSequence);
+		Options.bScaleKeys = !HasFlag(Argc, Argv, "--no-scale");
+		return Save(Synthetic::GenerateAnim(Options), Output) ? 0 : 1;
+	}
+
+	if (Mode == "suite")
+	{
+		auto bSucceeded = true;
+		for (const auto& [Label, Triangles] : { std::pair{ "1K", 1000 }, { "10K", 10000 }, { "100K", 100000 }, { "1M", 1000000 }, { "10M", 10000000 } })
+		{
+			Synthetic::MeshOptions Options;
+			Options.Triangles = Triangles;
+			bSucceeded &= Save(Synthetic::GenerateMesh(Options), Output + "/Synthetic_" + Label + ".psk");
+		}
+		bSucceeded &= Save(Synthetic::GenerateAnim(Synthetic::AnimOptions()), Output + "/Synthetic.psa");
+		return bSucceeded ? 0 : 1;
+	}
+
+	std::fprintf(stderr, "Unknown mode %s\n", Mode.c_str());
+	return 2;
+}
@@ -0,0 +1,247 @@
+﻿#include "ActorXCore/ActorXScan.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+
+/*
+ * Writes a manifest of every ActorX file under the given directories: validity, element counts, material names and
+ * chunk list, from chunk headers only.
+ *
+ * ActorXScan <Directory|File>... [--json File] [--csv File] [--threads N]
+ *
+ * Without --json or --csv the json manifest goes to stdout. The exit code is 1 if any file is invalid.
+ */
+
+using namespace ActorX;
+
+static bool IsActorXFile(const std::filesystem::path& Path)
+{
+	auto Extension = Path.extension().string();
+	std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](const unsigned char Char) { return static_cast<char>(std::tolower(Char)); });
+	return Extension == ".psk" || Extension == ".pskx" || Extension == ".psa";
+}
+
+static void GatherFiles(const std::string& Source, std::vector<std::string>& OutFiles)
+{
+	std::error_code Error;
+	if (!std::filesystem::is_directory(Source, Error))
+	{
+		OutFiles.push_back(Source);
+		return;
+	}
+
+	const auto Options = std::filesystem::directory_options::skip_permission_denied;
+	for (auto It = std::filesystem::recursive_directory_iterator(Source, Options, Error); !Error && It != std::filesystem::recursive_directory_iterator(); It.increment(Error))
+	{
+		if (It->is_regular_file(Error) && IsActorXFile(It->path()))
+		{
+			OutFiles.push_back(It->path().string());
+		}
+	}
+}
+
+static std::string EscapeJson(const std::string& Value)
+{
+	std::string Escaped;
+	Escaped.reserve(Value.size() + 2);
+	for (const auto Char : Value)
+	{
+		switch (Char)
+		{
+		case '"': Escaped += "\\\""; break;
+		case '\\': Escaped += "\\\\"; break;
+		case '\n': Escaped += "\\n"; break;
+		case '\r': Escaped += "\\r"; break;
+		case '\t': Escaped += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(Char) < 0x20)
+			{
+				char Code[8];
+				std::snprintf(Code, sizeof Code, "\\u%04x", Char);
+				Escaped += Code;
+			}
+			else
+			{
+				Escaped += Char;
+			}
+		}
+	}
+	return Escaped;
+}
+
+static std::string EscapeCsv(const std::string& Value)
+{
+	if (Value.find_first_of(",\"\n\r") == std::string::npos) return Value;
+
+	std::string Escaped = "\"";
+	for (const auto Char : Value)
+	{
+		Escaped += Char;
+		if (Char == '"') Escaped += '"';
+	}
+	return Escaped + "\"";
+}
+
+static std::string JoinNames(const std::vector<std::string>& Names, const char* Separator)
+{
+	std::string Joined;
+	for (size_t i = 0; i < Names.size(); i++)
+	{
+		if (i > 0) Joined += Separator;
+		Joined += Names[i];
+	}
+	return Joined;
+}
+
+static std::string JsonNames(const std::vector<std::string>& Names)
+{
+	std::string Json = "[";
+	for (size_t i = 0; i < Names.size(); i++)
+	{
+		Json += (i > 0 ? ",\"" : "\"") + EscapeJson(Names[i]) + "\"";
+	}
+	return Json + "]";
+}
+
+static void WriteJson(std::FILE* Out, const std::vector<FileSummary>& Summaries, const size_t NumValid, const double Seconds)
+{
+	std::fprintf(Out, "{\"files\":%zu,\"valid\":%zu,\"seconds\":%.6f,\"entries\":[", Summaries.size(), NumValid, Seconds);
+	for (size_t i = 0; i < Summaries.size(); i++)
+	{
+		const auto& Summary = Summaries[i];
+		std::fprintf(Out, "%s\n{\"file\":\"%s\",\"valid\":%s,\"result\":\"%s\",\"problem\":\"%s\",\"kind\":\"%s\",\"file_size\":%llu",
+			i > 0 ? "," : "", EscapeJson(Summary.Filename).c_str(), Summary.IsValid() ? "true" : "false", GetParseResultName(Summary.Result),
+			EscapeJson(Summary.Problem).c_str(), Summary.bIsAnimation ? "animation" : "mesh", static_cast<unsigned long long>(Summary.FileSize));
+		std::fprintf(Out, ",\"points\":%lld,\"wedges\":%lld,\"faces\":%lld,\"bones\":%lld,\"influences\":%lld,\"uv_channels\":%d,\"anim_keys\":%lld",
+			static_cast<long long>(Summary.Points), static_cast<long long>(Summary.Wedges), static_cast<long long>(Summary.Faces),
+			static_cast<long long>(Summary.Bones), static_cast<long long>(Summary.Influences), Summary.UVChannels, static_cast<long long>(Summary.AnimKeys));
+		std::fprintf(Out, ",\"materials\":%s,\"morph_targets\":%s,\"sequences\":%s,\"chunks\":[",
+			JsonNames(Summary.MaterialNames).c_str(), JsonNames(Summary.MorphTargetNames).c_str(), JsonNames(Summary.SequenceNames).c_str());
+		for (size_t j = 0; j < Summary.Chunks.size(); j++)
+		{
+			const auto& Chunk = Summary.Chunks[j];
+			std::fprintf(Out, "%s{\"name\":\"%s\",\"element_size\":%d,\"count\":%d,\"offset\":%llu}", j > 0 ? "," : "",
+				EscapeJson(Chunk.Name).c_str(), Chunk.DataSize, Chunk.DataCount, static_cast<unsigned long long>(Chunk.Offset));
+		}
+		std::fprintf(Out, "]}");
+	}
+	std::fprintf(Out, "\n]}\n");
+}
+
+static void WriteCsv(std::FILE* Out, const std::vector<FileSummary>& Summaries)
+{
+	std::fprintf(Out, "file,valid,result,problem,kind,file_size,points,wedges,faces,bones,influences,uv_channels,anim_keys,materials,morph_targets,sequences,chunks\n");
+	for (const auto& Summary : Summaries)
+	{
+		std::vector<std::string> ChunkNames;
+		for (const auto& Chunk : Summary.Chunks)
+		{
+			ChunkNames.push_back(Chunk.Name);
+		}
+		
+		std::fprintf(Out, "%s,%d,%s,%s,%s,%llu,%lld,%lld,%lld,%lld,%lld,%d,%lld,%s,%s,%s,%s\n",
+			EscapeCsv(Summary.Filename).c_str(), Summary.IsValid() ? 1 : 0, GetParseResultName(Summary.Result), EscapeCsv(Summary.Problem).c_str(),
+			Summary.bIsAnimation ? "animation" : "mesh", static_cast<unsigned long long>(Summary.FileSize),
+			static_cast<long long>(Summary.Points), static_cast<long long>(Summary.Wedges), static_cast<long long>(Summary.Faces),
+			static_cast<long long>(Summary.Bones), static_cast<long long>(Summary.Influences), Summary.UVChannels, static_cast<long long>(Summary.AnimKeys),
+			EscapeCsv(JoinNames(Summary.MaterialNames, ";")).c_str(), EscapeCsv(JoinNames(Summary.MorphTargetNames, ";")).c_str(),
+			EscapeCsv(JoinNames(Summary.SequenceNames, ";")).c_str(), EscapeCsv(JoinNames(ChunkNames, ";")).c_str());
+	}
+}
+
+template <typename WriteFuncType>
+static bool WriteManifest(const std::string& Filename, WriteFuncType&& Write)
+{
+	const auto File = std::fopen(Filename.c_str(), "wb");
+	if (File == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open %s\n", Filename.c_str());
+		return false;
+	}
+
+	Write(File);
+	return std::fclose(File) == 0;
+}
+
+int main(int Argc, char** Argv)
+{
+	std::vector<std::string> Sources;
+	std::string JsonFilename;
+	std::string CsvFilename;
+	auto NumThreads = static_cast<int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+
+	for (auto i = 1; i < Argc; i++)
+	{
+		const std::string Arg = Argv[i];
+		if (Arg == "--json" && i + 1 < Argc) JsonFilename = Argv[++i];
+		else if (Arg == "--csv" && i + 1 < Argc) CsvFilename = Argv[++i];
+		else if (Arg == "--threads" && i + 1 < Argc) NumThreads = std::max(1, std::atoi(Argv[++i]));
+		else if (Arg.rfind("--", 0) == 0)
+		{
+			Sources.clear();
+			break;
+		}
+		else Sources.push_back(Arg);
+	}
+
+	if (Sources.empty())
+	{
+		std::fprintf(stderr, "Usage: %s <Directory|File>... [--json File] [--csv File] [--threads N]\n", Argv[0]);
+		return 2;
+	}
+
+	const auto Start = std::chrono::steady_clock::now();
+	
+	std::vector<std::string> Files;
+	for (const auto& Source : Sources)
+	{
+		GatherFiles(Source, Files);
+	}
+	std::sort(Files.begin(), Files.end());
+
+	// files are handed out one at a time, scanning is dominated by open and seek latency rather than bytes
+	std::vector<FileSummary> Summaries(Files.size());
+	std::atomic<size_t> NextFile { 0 };
+	std::vector<std::thread> Workers;
+	for (auto i = 0; i < std::min<int32_t>(NumThreads, static_cast<int32_t>(std::max<size_t>(Files.size(), 1))); i++)
+	{
+		Workers.emplace_back([&]
+		{
+			for (auto Index = NextFile++; Index < Files.size(); Index = NextFile++)
+			{
+				Summaries[Index] = ScanFile(Files[Index]);
+			}
+		});
+	}
+	for (auto& Worker : Workers)
+	{
+		Worker.join();
+	}
+
+	const auto Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	const auto NumValid = static_cast<size_t>(std::count_if(Summaries.begin(), Summaries.end(), [](const FileSummary& Summary) { return Summary.IsValid(); }));
+
+	auto bSucceeded = true;
+	if (!JsonFilename.empty())
+	{
+		bSucceeded &= WriteManifest(JsonFilename, [&](std::FILE* File) { WriteJson(File, Summaries, NumValid, Seconds); });
+	}
+	if (!CsvFilename.empty())
+	{
+		bSucceeded &= WriteManifest(CsvFilename, [&](std::FILE* File) { WriteCsv(File, Summaries); });
+	}
+	if (JsonFilename.empty() && CsvFilename.empty())
+	{
+		WriteJson(stdout, Summaries, NumValid, Seconds);
+	}
+
+	std::fprintf(stderr, "Scanned %zu files in %.3fs (%.0f files/s), %zu invalid\n", Summaries.size(), Seconds,
+		Seconds > 0.0 ? Summaries.size() / Seconds : 0.0, Summaries.size() - NumValid);
+	
+	if (!bSucceeded) return 2;
+	return NumValid == Summaries.size() ? 0 : 1;
+}
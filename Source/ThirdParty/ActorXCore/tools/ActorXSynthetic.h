@@ -0,0 +1,198 @@
+﻿#pragma once
+
+#include "ActorXCore/ActorXWriter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+/*
+ * Deterministic synthetic ActorX files for benchmarks: a subdivided grid with every optional mesh chunk filled in,
+ * and animations with a key for every bone on every frame.
+ */
+namespace ActorX::Synthetic
+{
+	struct MeshOptions
+	{
+		int64_t Triangles = 1000;
+		int32_t Materials = 4;
+		int32_t ExtraUVChannels = 1;
+		int32_t Bones = 64;
+		int32_t InfluencesPerPoint = 4;
+		int32_t MorphTargets = 0;
+		// fraction of points moved by every morph target
+		float MorphCoverage = 0.1f;
+	};
+
+	struct AnimOptions
+	{
+		int32_t Bones = 64;
+		int32_t Sequences = 4;
+		int32_t FramesPerSequence = 300;
+		bool bScaleKeys = true;
+	};
+
+	inline void SetName(char* Out, const size_t Size, const std::string& Name)
+	{
+		std::memset(Out, 0, Size);
+		std::memcpy(Out, Name.data(), std::min(Name.size(), Size - 1));
+	}
+
+	inline std::vector<NamedBone> MakeBones(const int32_t Count)
+	{
+		std::vector<NamedBone> Bones(Count);
+		for (auto i = 0; i < Count; i++)
+		{
+			auto& Bone = Bones[i];
+			SetName(Bone.Name, sizeof Bone.Name, "bone_" + std::to_string(i));
+			Bone.Flags = 0;
+			Bone.NumChildren = i + 1 < Count ? 1 : 0;
+			Bone.ParentIndex = i > 0 ? i - 1 : 0;
+			Bone.BonePos = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, i > 0 ? 10.0f : 0.0f }, 10.0f, 1.0f, 1.0f, 1.0f };
+		}
+		return Bones;
+	}
+
+	inline std::vector<uint8_t> GenerateMesh(const MeshOptions& Options)
+	{
+		// a grid of Columns x Rows quads, the last row only partially filled to hit the exact triangle count
+		const auto Quads = (Options.Triangles + 1) / 2;
+		const auto Columns = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(std::sqrt(static_cast<double>(Quads)))));
+		const auto Rows = (Quads + Columns - 1) / Columns;
+		const auto NumPoints = static_cast<int32_t>((Columns + 1) * (Rows + 1));
+
+		std::vector<Vector3> Points(NumPoints);
+		std::vector<Wedge> Wedges(NumPoints);
+		std::vector<Vector3> Normals(NumPoints, Vector3{ 0.0f, 0.0f, 1.0f });
+		std::vector<Color> Colors(NumPoints);
+		std::vector<Vector2> ExtraUVs(NumPoints);
+		for (auto i = 0; i < NumPoints; i++)
+		{
+			const auto X = static_cast<float>(i % (Columns + 1));
+			const auto Y = static_cast<float>(i / (Columns + 1));
+			Points[i] = { X, Y, std::sin(X * 0.1f) * std::cos(Y * 0.1f) };
+			Wedges[i] = { static_cast<uint32_t>(i), X / Columns, Y / Rows, static_cast<uint8_t>(i % Options.Materials), 0, 0 };
+			Colors[i] = { static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i >> 16), 255 };
+			ExtraUVs[i] = { Y / Rows, X / Columns };
+		}
+
+		std::vector<Face> Faces(Options.Triangles);
+		for (int64_t i = 0; i < Options.Triangles; i++)
+		{
+			const auto Quad = i / 2;
+			const auto Corner = static_cast<int32_t>((Quad / Columns) * (Columns + 1) + Quad % Columns);
+			const auto Right = Corner + 1;
+			const auto Up = Corner + static_cast<int32_t>(Columns) + 1;
+			auto& Face = Faces[i];
+			if (i % 2 == 0)
+			{
+				Face.WedgeIndex[0] = Corner;
+				Face.WedgeIndex[1] = Up;
+				Face.WedgeIndex[2] = Right;
+			}
+			else
+			{
+				Face.WedgeIndex[0] = Right;
+				Face.WedgeIndex[1] = Up;
+				Face.WedgeIndex[2] = Up + 1;
+			}
+			Face.MatIndex = static_cast<uint8_t>(Quad % Options.Materials);
+			Face.AuxMatIndex = 0;
+			Face.SmoothingGroups = 1;
+		}
+
+		std::vector<Material> Materials(Options.Materials);
+		for (auto i = 0; i < Options.Materials; i++)
+		{
+			Materials[i] = {};
+			SetName(Materials[i].MaterialName, sizeof Materials[i].MaterialName, "material_" + std::to_string(i));
+		}
+
+		const auto NumBones = std::max(Options.Bones, 1);
+		std::vector<RawBoneInfluence> Influences;
+		Influences.reserve(static_cast<size_t>(NumPoints) * Options.InfluencesPerPoint);
+		for (auto i = 0; i < NumPoints; i++)
+		{
+			for (auto j = 0; j < Options.InfluencesPerPoint; j++)
+			{
+				Influences.push_back({ 1.0f / Options.InfluencesPerPoint, i, (i + j) % NumBones });
+			}
+		}
+
+		ChunkWriter Writer("ACTRHEAD");
+		Writer.WriteChunk("PNTS0000", Points);
+		Writer.WriteChunk("VTXW0000", Wedges);
+		Writer.WriteFaces(Faces.data(), static_cast<int32_t>(Faces.size()), NumPoints);
+		Writer.WriteChunk("MATT0000", Materials);
+		Writer.WriteChunk("REFSKELT", MakeBones(NumBones));
+		Writer.WriteChunk("RAWWEIGHTS", Influences);
+		Writer.WriteChunk("VTXNORMS", Normals);
+		Writer.WriteChunk("VERTEXCOLOR", Colors);
+		for (auto i = 0; i < Options.ExtraUVChannels; i++)
+		{
+			Writer.WriteChunk("EXTRAUVS", ExtraUVs);
+		}
+
+		if (Options.MorphTargets > 0)
+		{
+			const auto PointsPerTarget = std::max(1, static_cast<int32_t>(NumPoints * Options.MorphCoverage));
+			std::vector<MorphInfo> MorphInfos(Options.MorphTargets);
+			std::vector<MorphData> MorphDatas;
+			MorphDatas.reserve(static_cast<size_t>(PointsPerTarget) * Options.MorphTargets);
+			for (auto i = 0; i < Options.MorphTargets; i++)
+			{
+				SetName(MorphInfos[i].Name, sizeof MorphInfos[i].Name, "morph_" + std::to_string(i));
+				MorphInfos[i].VertexCount = PointsPerTarget;
+				for (auto j = 0; j < PointsPerTarget; j++)
+				{
+					MorphDatas.push_back({ { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, (i * 7919 + j) % NumPoints });
+				}
+			}
+			Writer.WriteChunk("MRPHINFO", MorphInfos);
+			Writer.WriteChunk("MRPHDATA", MorphDatas);
+		}
+
+		return std::move(Writer.GetBuffer());
+	}
+
+	inline std::vector<uint8_t> GenerateAnim(const AnimOptions& Options)
+	{
+		std::vector<AnimInfo> AnimInfos(Options.Sequences);
+		for (auto i = 0; i < Options.Sequences; i++)
+		{
+			auto& Info = AnimInfos[i];
+			Info = {};
+			SetName(Info.Name, sizeof Info.Name, "sequence_" + std::to_string(i));
+			SetName(Info.Group, sizeof Info.Group, "None");
+			Info.TotalBones = Options.Bones;
+			Info.AnimRate = 30.0f;
+			Info.TrackTime = static_cast<float>(Options.FramesPerSequence);
+			Info.FirstRawFrame = i * Options.FramesPerSequence;
+			Info.NumRawFrames = Options.FramesPerSequence;
+		}
+
+		const auto NumKeys = static_cast<size_t>(Options.Sequences) * Options.FramesPerSequence * Options.Bones;
+		std::vector<QuatAnimKey> Keys(NumKeys);
+		std::vector<ScaleAnimKey> ScaleKeys(Options.bScaleKeys ? NumKeys : 0);
+		for (size_t i = 0; i < NumKeys; i++)
+		{
+			const auto Angle = static_cast<float>(i / Options.Bones) * 0.01f;
+			Keys[i] = { { 0.0f, 0.0f, 10.0f }, { 0.0f, 0.0f, std::sin(Angle), std::cos(Angle) }, 1.0f };
+			if (Options.bScaleKeys)
+			{
+				ScaleKeys[i] = { { 1.0f, 1.0f, 1.0f }, 1.0f };
+			}
+		}
+
+		ChunkWriter Writer("ANIMHEAD");
+		Writer.WriteChunk("BONENAMES", MakeBones(Options.Bones));
+		Writer.WriteChunk("ANIMINFO", AnimInfos);
+		Writer.WriteChunk("ANIMKEYS", Keys);
+		if (Options.bScaleKeys)
+		{
+			Writer.WriteChunk("SCALEKEYS", ScaleKeys);
+		}
+
+		return std::move(Writer.GetBuffer());
+	}
+}
@@ -0,0 +1,276 @@
+﻿#include "PsaFactory.h"
+
+#include "PskImportStats.h"
+#include "PskImportTransaction.h"
+#include "PskPsaUtils.h"
+#include "UnrealPSKPSA.h"
+#include "Algo/AllOf.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/AnimData/IAnimationDataController.h"
+#include "AssetRegistry/ARFilter.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Async/ParallelFor.h"
+
+struct FPsaBoneTrack
+{
+	FName BoneName;
+	TArray<FVector3f> PositionalKeys;
+	TArray<FQuat4f> RotationalKeys;
+	TArray<FVector3f> ScalingKeys;
+};
+
+enum class EPsaTrackReduction : uint8
+{
+	// the bone is not part of the skeleton
+	Skipped,
+	Animated,
+	Constant,
+	Removed
+};
+
+template <typename KeyType, typename ErrorFuncType>
+static bool IsConstant(const TArray<KeyType>& Keys, const float Tolerance, ErrorFuncType&& ErrorFunc)
+{
+	for (auto i = 1; i < Keys.Num(); i++)
+	{
+		if (ErrorFunc(Keys[0], Keys[i]) > Tolerance) return false;
+	}
+	return true;
+}
+
+static float GetPositionError(const FVector3f& A, const FVector3f& B)
+{
+	return FVector3f::Distance(A, B);
+}
+
+static float GetRotationError(const FQuat4f& A, const FQuat4f& B)
+{
+	return A.AngularDistance(B);
+}
+
+static float GetScaleError(const FVector3f& A, const FVector3f& B)
+{
+	return (A - B).GetAbsMax();
+}
+
+// collapses a track that never moves to its first key, or removes it when that key is the reference pose
+static EPsaTrackReduction ReduceTrack(FPsaBoneTrack& Track, const FTransform& RefPose, const FPsaKeyReductionSettings& Settings)
+{
+	if (!IsConstant(Track.PositionalKeys, Settings.PositionTolerance, &GetPositionError)
+		|| !IsConstant(Track.RotationalKeys, Settings.RotationTolerance, &GetRotationError)
+		|| !IsConstant(Track.ScalingKeys, Settings.ScaleTolerance, &GetScaleError))
+	{
+		return EPsaTrackReduction::Animated;
+	}
+
+	if (Settings.bRemoveReferencePoseTracks
+		&& GetPositionError(Track.PositionalKeys[0], FVector3f(RefPose.GetLocation())) <= Settings.PositionTolerance
+		&& GetRotationError(Track.RotationalKeys[0], FQuat4f(RefPose.GetRotation())) <= Settings.RotationTolerance
+		&& GetScaleError(Track.ScalingKeys[0], FVector3f(RefPose.GetScale3D())) <= Settings.ScaleTolerance)
+	{
+		Track.PositionalKeys.Empty();
+		Track.RotationalKeys.Empty();
+		Track.ScalingKeys.Empty();
+		return EPsaTrackReduction::Removed;
+	}
+
+	Track.PositionalKeys.SetNum(1);
+	Track.RotationalKeys.SetNum(1);
+	Track.ScalingKeys.SetNum(1);
+	return EPsaTrackReduction::Constant;
+}
+
+static UAnimSequence* ImportSequence(const FPsaReader& Data, const VAnimInfoBinary& Info, UObject* Parent, const FString& AssetName, const EObjectFlags Flags, USkeleton* Skeleton, const FPsaKeyReductionSettings& KeyReduction, FPskImportReport& Report)
+{
+	auto& Timings = Report.Timings;
+	
+	if (!Data.IsSequenceInBounds(Info))
+	{
+		UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s: keys run past the end of ANIMKEYS, skipping"), ANSI_TO_TCHAR(Info.Name));
+		return nullptr;
+	}
+
+	const auto& RefSkeleton = Skeleton->GetReferenceSkeleton();
+	const auto NumFrames = Info.NumRawFrames;
+
+	// each bone track reads its keys straight from the mapped file, so only one sequence is ever converted at once.
+	// Tracks are reduced by the same task that converted them, while their keys are still in cache
+	TArray<FPsaBoneTrack> Tracks;
+	TArray<EPsaTrackReduction> Reductions;
+	Tracks.SetNum(Info.TotalBones);
+	Reductions.Init(EPsaTrackReduction::Skipped, Info.TotalBones);
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Convert, Timings.Convert);
+		
+		ParallelFor(Info.TotalBones, [&](const int32 BoneIndex)
+		{
+			auto& Track = Tracks[BoneIndex];
+			Track.BoneName = FName(Data.Bones[BoneIndex].Name);
+			const auto SkeletonBoneIndex = RefSkeleton.FindBoneIndex(Track.BoneName);
+			if (SkeletonBoneIndex == INDEX_NONE) return;
+		
+			Track.PositionalKeys.SetNumUninitialized(NumFrames);
+			Track.RotationalKeys.SetNumUninitialized(NumFrames);
+			Track.ScalingKeys.SetNumUninitialized(NumFrames);
+			for (auto Frame = 0; Frame < NumFrames; Frame++)
+			{
+				const auto KeyIndex = FPsaReader::GetKeyIndex(Info, Frame, BoneIndex);
+				const auto Key = Data.GetKey(KeyIndex);
+			
+				Track.PositionalKeys[Frame] = FVector3f(Key.Position.X, -Key.Position.Y, Key.Position.Z); // MIRROR_MESH
+				Track.RotationalKeys[Frame] = FQuat4f(Key.Orientation.X, -Key.Orientation.Y, Key.Orientation.Z, Key.Orientation.W).GetNormalized();
+				Track.ScalingKeys[Frame] = Data.bHasScaleKeys ? Data.GetScaleKey(KeyIndex).ScaleVector : FVector3f::OneVector;
+			}
+
+			Reductions[BoneIndex] = EPsaTrackReduction::Animated;
+			if (KeyReduction.bEnabled && NumFrames > 0)
+			{
+				Reductions[BoneIndex] = ReduceTrack(Track, RefSkeleton.GetRefBonePose()[SkeletonBoneIndex], KeyReduction);
+			}
+		});
+	}
+
+	FPsaKeyReductionStats Stats;
+	for (auto BoneIndex = 0; BoneIndex < Tracks.Num(); BoneIndex++)
+	{
+		if (Reductions[BoneIndex] == EPsaTrackReduction::Skipped) continue;
+		
+		Stats.Tracks++;
+		Stats.KeysIn += NumFrames;
+		Stats.KeysOut += Tracks[BoneIndex].PositionalKeys.Num();
+		Stats.ConstantTracks += Reductions[BoneIndex] == EPsaTrackReduction::Constant;
+		Stats.RemovedTracks += Reductions[BoneIndex] == EPsaTrackReduction::Removed;
+	}
+	Report.Counters.AnimKeysRemoved += Stats.KeysIn - Stats.KeysOut;
+	
+	UE_LOG(LogUnrealPSKPSA, Log, TEXT("%s: kept %lld of %lld keys (%.1f%% removed), %d of %d tracks constant, %d removed"),
+		*AssetName, Stats.KeysOut, Stats.KeysIn, Stats.GetRemovedRatio() * 100.0, Stats.ConstantTracks, Stats.Tracks, Stats.RemovedTracks);
+
+	PSK_IMPORT_STAGE(STAT_PskImport_Animation, Timings.Create);
+
+	const auto AnimSequence = FPskPsaUtils::LocalCreate<UAnimSequence>(UAnimSequence::StaticClass(), Parent, AssetName, Flags);
+	AnimSequence->SetSkeleton(Skeleton);
+
+	const auto FrameRate = FMath::Max(FMath::RoundToInt(Info.AnimRate), 1);
+	
+	auto& Controller = AnimSequence->GetController();
+	Controller.OpenBracket(FText::FromString("Importing PSA"), false);
+	Controller.ResetModel(false);
+	Controller.SetFrameRate(FFrameRate(FrameRate, 1), false);
+	Controller.SetPlayLength(FMath::Max(NumFrames - 1, 1) / static_cast<float>(FrameRate), false);
+	for (const auto& Track : Tracks)
+	{
+		if (Track.PositionalKeys.IsEmpty()) continue;
+		
+		Controller.AddBoneCurve(Track.BoneName, false);
+		Controller.SetBoneTrackKeys(Track.BoneName, Track.PositionalKeys, Track.RotationalKeys, Track.ScalingKeys, false);
+	}
+	Controller.NotifyPopulated();
+	Controller.CloseBracket(false);
+
+	FPskImportTransaction::AssetChanged(AnimSequence, true);
+
+	return AnimSequence;
+}
+
+UObject* UPsaFactory::Import(const FString& Filename, UObject* Parent, const FName Name, const EObjectFlags Flags, USkeleton* Skeleton, const FPsaKeyReductionSettings& KeyReduction)
+{
+	FPskImportReport Report;
+	Report.Filename = Filename;
+	
+	TUniquePtr<FPsaReader> Reader;
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Read, Report.Timings.Read);
+		Reader = MakeUnique<FPsaReader>(Filename);
+	}
+	
+	const auto& Data = *Reader;
+	if (!Data.bIsValid)
+	{
+		Report.Finish(nullptr);
+		return nullptr;
+	}
+
+	Report.Counters.BytesRead = Data.GetFileSize();
+	Report.Counters.Bones = Data.Bones.Num();
+	Report.Counters.AnimKeys = Data.GetNumKeys();
+
+	if (Skeleton == nullptr)
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Skeleton, Report.Timings.Skeleton);
+		Skeleton = FindSkeleton(Parent, Data);
+	}
+	
+	if (Skeleton == nullptr)
+	{
+		UE_LOG(LogUnrealPSKPSA, Error, TEXT("%s: no skeleton containing all %d of its bones was found in or above the import location"), *Filename, Data.Bones.Num());
+		Report.Finish(nullptr);
+		return nullptr;
+	}
+
+	UObject* FirstSequence = nullptr;
+	for (const auto& Info : Data.AnimInfos)
+	{
+		// single sequence files are named after the file, like psk imports
+		const auto AssetName = Data.AnimInfos.Num() == 1 ? Name.ToString() : FString(Info.Name);
+		const auto AnimSequence = ImportSequence(Data, Info, Parent, AssetName, Flags, Skeleton, KeyReduction, Report);
+		if (FirstSequence == nullptr)
+		{
+			FirstSequence = AnimSequence;
+		}
+	}
+
+	Report.Finish(FirstSequence);
+	return FirstSequence;
+}
+
+USkeleton* UPsaFactory::FindSkeleton(const UObject* Parent, const FPsaReader& Data)
+{
+	const auto& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+
+	// only skeleton assets are loaded, and only from the searched folders themselves, never from everything below them
+	FARFilter Filter;
+	Filter.ClassPaths.Add(USkeleton::StaticClass()->GetClassPathName());
+	Filter.bRecursiveClasses = true;
+	Filter.bRecursivePaths = false;
+	
+	// walk up from the import location, skeletons usually live next to or just above their animations
+	auto SearchPath = FPaths::GetPath(Parent->GetPathName());
+	for (auto Depth = 0; Depth < 3 && !SearchPath.IsEmpty(); Depth++)
+	{
+		Filter.PackagePaths.Reset();
+		Filter.PackagePaths.Add(FName(SearchPath));
+		
+		TArray<FAssetData> Assets;
+		AssetRegistry.GetAssets(Filter, Assets);
+
+		// every bone of the psa has to be in the skeleton, otherwise its tracks would be dropped without notice.
+		// Of the skeletons that qualify the smallest fits best
+		USkeleton* BestSkeleton = nullptr;
+		for (const auto& Asset : Assets)
+		{
+			const auto Skeleton = Cast<USkeleton>(Asset.GetAsset());
+			if (Skeleton == nullptr) continue;
+
+			const auto& RefSkeleton = Skeleton->GetReferenceSkeleton();
+			const auto bHasAllBones = Algo::AllOf(Data.Bones, [&RefSkeleton](const VNamedBoneBinary& Bone)
+			{
+				return RefSkeleton.FindBoneIndex(FName(Bone.Name)) != INDEX_NONE;
+			});
+			
+			if (bHasAllBones && (BestSkeleton == nullptr || RefSkeleton.GetNum() < BestSkeleton->GetReferenceSkeleton().GetNum()))
+			{
+				BestSkeleton = Skeleton;
+			}
+		}
+
+		if (BestSkeleton != nullptr)
+		{
+			return BestSkeleton;
+		}
+		
+		SearchPath = FPaths::GetPath(SearchPath);
+	}
+	
+	return nullptr;
+}
@@ -0,0 +1,79 @@
+﻿#include "PsaReader.h"
+
+#include "UnrealPSKPSA.h"
+
+// on-disk element sizes, the in-memory structs may be padded around their quaternions
+constexpr int32 PackedAnimKeySize = ActorX::PackedSize::AnimKey;
+constexpr int32 PackedScaleKeySize = ActorX::PackedSize::ScaleKey;
+
+FPsaReader::FPsaReader(const FString& Filepath)
+{
+	if (!File.Open(Filepath) || !File.ReadChunkDirectory("ANIMHEAD", Chunks))
+	{
+		return;
+	}
+
+	for (const auto& Chunk : Chunks)
+	{
+		const auto& Header = Chunk.Header;
+		if (Header.ChunkHash == PskChunkHash("BONENAMES"))
+		{
+			Bones = FPskReader::UnpackBones(Chunk, BonesStorage);
+		}
+		else if (Header.ChunkHash == PskChunkHash("ANIMINFO"))
+		{
+			if (Header.Size != sizeof(VAnimInfoBinary)) continue;
+			
+			AnimInfos.SetNumUninitialized(Header.Count);
+			FMemory::Memcpy(AnimInfos.GetData(), Chunk.Data, Header.GetDataSize());
+		}
+		else if (Header.ChunkHash == PskChunkHash("ANIMKEYS"))
+		{
+			if (Header.Size != PackedAnimKeySize) continue;
+			
+			KeysChunk = &Chunk;
+		}
+		else if (Header.ChunkHash == PskChunkHash("SCALEKEYS"))
+		{
+			if (Header.Size != PackedScaleKeySize) continue;
+			
+			ScaleKeysChunk = &Chunk;
+		}
+	}
+
+	bIsValid = Bones.Num() > 0 && AnimInfos.Num() > 0 && KeysChunk != nullptr;
+	bHasScaleKeys = bIsValid && ScaleKeysChunk != nullptr && ScaleKeysChunk->Header.Count == KeysChunk->Header.Count;
+}
+
+VQuatAnimKey FPsaReader::GetKey(const int32 KeyIndex) const
+{
+	checkf(KeyIndex >= 0 && KeyIndex < GetNumKeys(), TEXT("Animation key %d out of bounds (%d)"), KeyIndex, GetNumKeys());
+	
+	const auto Packed = KeysChunk->Data + static_cast<int64>(KeyIndex) * PackedAnimKeySize;
+	
+	VQuatAnimKey Key;
+	ActorX::UnpackAnimKey(Packed, Key);
+	return Key;
+}
+
+VScaleAnimKey FPsaReader::GetScaleKey(const int32 KeyIndex) const
+{
+	checkf(bHasScaleKeys && KeyIndex >= 0 && KeyIndex < GetNumKeys(), TEXT("Scale key %d out of bounds (%d)"), KeyIndex, GetNumKeys());
+	
+	const auto Packed = ScaleKeysChunk->Data + static_cast<int64>(KeyIndex) * PackedScaleKeySize;
+	
+	VScaleAnimKey Key;
+	ActorX::UnpackScaleKey(Packed, Key);
+	return Key;
+}
+
+bool FPsaReader::IsSequenceInBounds(const VAnimInfoBinary& Info) const
+{
+	if (Info.TotalBones <= 0 || Info.TotalBones > Bones.Num() || Info.FirstRawFrame < 0 || Info.NumRawFrames <= 0)
+	{
+		return false;
+	}
+	
+	const auto LastKey = (static_cast<int64>(Info.FirstRawFrame) + Info.NumRawFrames) * Info.TotalBones;
+	return LastKey <= GetNumKeys();
+}
@@ -0,0 +1,132 @@
+﻿#include "PskAssetImportData.h"
+
+#include "PskReader.h"
+#include "Async/ParallelFor.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+#include "Hash/CityHash.h"
+#include "Materials/MaterialInterface.h"
+#include "Misc/PackageName.h"
+
+// materials are resolved by name only, so an edit here never needs the geometry rebuilt
+static const FString MaterialsChunkName = TEXT("MATT0000");
+
+EPskReimportChange UPskAssetImportData::Compare(const TArray<FPskChunkHash>& NewChunkHashes) const
+{
+	if (ChunkHashes.Num() != NewChunkHashes.Num()) return EPskReimportChange::Full;
+
+	auto Change = EPskReimportChange::None;
+	for (auto i = 0; i < ChunkHashes.Num(); i++)
+	{
+		const auto& Old = ChunkHashes[i];
+		const auto& New = NewChunkHashes[i];
+		if (Old.ChunkName != New.ChunkName) return EPskReimportChange::Full;
+		if (Old.Hash == New.Hash) continue;
+		if (New.ChunkName != MaterialsChunkName) return EPskReimportChange::Full;
+		
+		Change = EPskReimportChange::MaterialsOnly;
+	}
+	return Change;
+}
+
+TArray<FPskChunkHash> UPskAssetImportData::HashChunks(const TArray<FPskChunk>& Chunks)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UPskAssetImportData::HashChunks);
+	
+	TArray<FPskChunkHash> Hashes;
+	Hashes.SetNum(Chunks.Num());
+	ParallelFor(Chunks.Num(), [&Chunks, &Hashes](const int32 Index)
+	{
+		const auto& Header = Chunks[Index].Header;
+		
+		// element size and count go into the seed so relayouts of the same bytes are caught
+		const auto Seed = (static_cast<uint64>(static_cast<uint32>(Header.Size)) << 32) | static_cast<uint32>(Header.Count);
+		Hashes[Index].ChunkName = ANSI_TO_TCHAR(Header.ChunkName);
+		
+		// CityHash takes 32-bit lengths, bigger chunks are hashed in blocks that chain the seed. Chunks that fit one
+		// block hash the same as they always did
+		const auto Data = reinterpret_cast<const char*>(Chunks[Index].Data);
+		const auto DataSize = Header.GetDataSize();
+		auto Hash = Seed;
+		auto Offset = static_cast<int64>(0);
+		do
+		{
+			const auto BlockSize = FMath::Min<int64>(DataSize - Offset, MAX_uint32);
+			Hash = CityHash64WithSeed(Data + Offset, static_cast<uint32>(BlockSize), Hash);
+			Offset += BlockSize;
+		}
+		while (Offset < DataSize);
+		Hashes[Index].Hash = Hash;
+	});
+	return Hashes;
+}
+
+uint64 UPskAssetImportData::GetContentHash(const TArray<FPskChunkHash>& ChunkHashes)
+{
+	auto Hash = static_cast<uint64>(ChunkHashes.Num());
+	for (const auto& ChunkHash : ChunkHashes)
+	{
+		const auto NameHash = static_cast<uint64>(GetTypeHash(ChunkHash.ChunkName));
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(&ChunkHash.Hash), sizeof ChunkHash.Hash, Hash ^ NameHash);
+	}
+	return Hash;
+}
+
+void UPskAssetImportData::AppendLODChunkHashes(TArray<FPskChunkHash>& ChunkHashes, const TArray<FPskChunkHash>& LODChunkHashes, const int32 LODIndex)
+{
+	for (auto ChunkHash : LODChunkHashes)
+	{
+		if (LODIndex > 0)
+		{
+			ChunkHash.ChunkName = FString::Printf(TEXT("LOD%d/%s"), LODIndex, *ChunkHash.ChunkName);
+		}
+		ChunkHashes.Add(MoveTemp(ChunkHash));
+	}
+}
+
+UPskAssetImportData* UPskAssetImportData::Get(const UObject* Mesh)
+{
+	if (const auto SkeletalMesh = Cast<USkeletalMesh>(Mesh))
+	{
+		return Cast<UPskAssetImportData>(SkeletalMesh->GetAssetImportData());
+	}
+	if (const auto StaticMesh = Cast<UStaticMesh>(Mesh))
+	{
+		return Cast<UPskAssetImportData>(StaticMesh->AssetImportData);
+	}
+	return nullptr;
+}
+
+UPskAssetImportData* UPskAssetImportData::Assign(UObject* Mesh, const FString& Filename, const TArray<FPskChunkHash>& ChunkHashes)
+{
+	// a mesh rebuilt in place keeps its import data object, anything else gets a new one
+	auto ImportData = Get(Mesh);
+	if (ImportData == nullptr)
+	{
+		ImportData = NewObject<UPskAssetImportData>(Mesh, TEXT("AssetImportData"));
+	}
+	// the chunk hashes stand in for the md5 of the whole file, which would cost another full read
+	ImportData->UpdateFilenameOnly(FPaths::ConvertRelativePathToFull(Filename));
+	ImportData->ChunkHashes = ChunkHashes;
+	
+	if (const auto SkeletalMesh = Cast<USkeletalMesh>(Mesh))
+	{
+		SkeletalMesh->SetAssetImportData(ImportData);
+	}
+	else if (const auto StaticMesh = Cast<UStaticMesh>(Mesh))
+	{
+		StaticMesh->AssetImportData = ImportData;
+	}
+	return ImportData;
+}
+
+void UPskAssetImportData::SetMaterials(const TArray<FString>& MaterialNames, const TArray<UMaterialInterface*>& Materials)
+{
+	MaterialNameToPathMap.Empty(MaterialNames.Num());
+	for (auto i = 0; i < FMath::Min(MaterialNames.Num(), Materials.Num()); i++)
+	{
+		if (Materials[i] == nullptr) continue;
+		
+		MaterialNameToPathMap.Add(MaterialNames[i], FPackageName::GetLongPackagePath(Materials[i]->GetOutermost()->GetName()));
+	}
+}
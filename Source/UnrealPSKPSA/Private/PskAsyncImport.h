@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "PskImportData.h"
+#include "PskPsaUtils.h"
+#include "UnrealPSKPSA.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Misc/ScopedSlowTask.h"
+
+/*
+ * Runs a factory's read stage on a background task while the game thread keeps a progress dialog responsive. Every
+ * stage the worker enters advances the dialog by one frame; canceling stops the worker before its next stage.
+ */
+class FPskAsyncImport
+{
+public:
+	template <typename MeshDataType>
+	static bool ReadMesh(FScopedSlowTask& SlowTask, const FString& Filename, MeshDataType& OutMeshData,
+						 bool (*ReadFunc)(const FString&, MeshDataType&, FPskImportProgress*), bool& bOutCanceled)
+	{
+		const auto CleanFilename = FText::FromString(FPaths::GetCleanFilename(Filename));
+		
+		FPskImportProgress Progress;
+		auto ReportedStage = EPskImportStage::Read;
+		SlowTask.EnterProgressFrame(1, FText::Format(NSLOCTEXT("UnrealPSKPSA", "ReadingFile", "Reading {0}"), CleanFilename));
+
+		// the worker only references locals of this frame, which outlives it because the loop waits for it
+		auto Future = Async(EAsyncExecution::ThreadPool, [&Filename, &OutMeshData, &Progress, ReadFunc]
+		{
+			return ReadFunc(Filename, OutMeshData, &Progress);
+		});
+		
+		while (!Future.WaitFor(FTimespan::FromMilliseconds(50)))
+		{
+			const auto Stage = Progress.Stage.load();
+			if (Stage != ReportedStage)
+			{
+				SlowTask.EnterProgressFrame(1, FText::Format(NSLOCTEXT("UnrealPSKPSA", "ConvertingFile", "Converting {0}"), CleanFilename));
+				ReportedStage = Stage;
+			}
+			else
+			{
+				SlowTask.TickProgress();
+			}
+
+			if (SlowTask.ShouldCancel())
+			{
+				Progress.bCancelRequested = true;
+			}
+		}
+
+		bOutCanceled = Progress.bCancelRequested;
+		return Future.Get() && !bOutCanceled;
+	}
+
+	/*
+	 * Reads Filename and its sibling _LODn files concurrently. A lower LOD that fails to read ends the chain there,
+	 * only LOD0 failing fails the whole read. Runs on any thread, like the read functions it calls.
+	 */
+	template <typename MeshDataType>
+	static bool ReadLODs(const FString& Filename, TArray<MeshDataType>& OutLODs, FPskImportProgress* Progress,
+						 bool (*ReadFunc)(const FString&, MeshDataType&, FPskImportProgress*))
+	{
+		const auto Filenames = FPskPsaUtils::FindLODFilenames(Filename);
+		
+		TArray<bool> Succeeded;
+		Succeeded.SetNumZeroed(Filenames.Num());
+		OutLODs.SetNum(Filenames.Num());
+		ParallelFor(Filenames.Num(), [&](const int32 LODIndex)
+		{
+			Succeeded[LODIndex] = ReadFunc(Filenames[LODIndex], OutLODs[LODIndex], Progress);
+		});
+
+		for (auto LODIndex = 1; LODIndex < OutLODs.Num(); LODIndex++)
+		{
+			if (Succeeded[LODIndex]) continue;
+			
+			UE_LOG(LogUnrealPSKPSA, Warning, TEXT("Failed to read %s, importing %s with %d LODs"), *Filenames[LODIndex], *Filename, LODIndex);
+			for (auto FailedIndex = LODIndex; FailedIndex < OutLODs.Num(); FailedIndex++)
+			{
+				OutLODs[FailedIndex].Report.Finish(nullptr);
+			}
+			OutLODs.SetNum(LODIndex);
+			break;
+		}
+		
+		return Succeeded[0];
+	}
+};
@@ -0,0 +1,100 @@
+﻿#include "PskBatchExporter.h"
+
+#include "PskExporter.h"
+#include "UnrealPSKPSA.h"
+#include "Async/ParallelFor.h"
+
+TArray<FPskBatchExportResult> FPskBatchExporter::Export(const TArray<FPskBatchExportTask>& Tasks, FPskBatchExportStats* OutStats)
+{
+	check(IsInGameThread());
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskBatchExporter::Export);
+	
+	const auto StartTime = FPlatformTime::Seconds();
+	
+	TArray<FPskBatchExportResult> Results;
+	Results.SetNum(Tasks.Num());
+
+	// loading bulk data and finishing async builds touch UObjects, everything after only reads them
+	TArray<bool> Prepared;
+	Prepared.SetNumUninitialized(Tasks.Num());
+	TSet<FString> Filenames;
+	for (auto Index = 0; Index < Tasks.Num(); Index++)
+	{
+		auto bDuplicate = false;
+		Filenames.Add(FPaths::ConvertRelativePathToFull(Tasks[Index].Filename), &bDuplicate);
+		if (bDuplicate)
+		{
+			UE_LOG(LogUnrealPSKPSA, Error, TEXT("%s is already written by another task, skipping %s"), *Tasks[Index].Filename, *GetNameSafe(Tasks[Index].Asset));
+			Prepared[Index] = false;
+			continue;
+		}
+		
+		Prepared[Index] = FPskExporter::Prepare(Tasks[Index].Asset);
+		if (!Prepared[Index])
+		{
+			UE_LOG(LogUnrealPSKPSA, Error, TEXT("%s has no data that can be exported"), *GetNameSafe(Tasks[Index].Asset));
+		}
+	}
+
+	// one task per asset, so the file writes of some assets overlap with gathering others
+	ParallelFor(Tasks.Num(), [&](const int32 Index)
+	{
+		if (!Prepared[Index]) return;
+
+		const auto TaskStartTime = FPlatformTime::Seconds();
+		auto& Result = Results[Index];
+		Result.bSucceeded = FPskExporter::ExportToFile(Tasks[Index].Asset, Tasks[Index].Filename, &Result.BytesWritten);
+		Result.Seconds = FPlatformTime::Seconds() - TaskStartTime;
+	});
+
+	FPskBatchExportStats Stats;
+	Stats.NumAssets = Tasks.Num();
+	Stats.TotalSeconds = FPlatformTime::Seconds() - StartTime;
+	for (auto Index = 0; Index < Tasks.Num(); Index++)
+	{
+		const auto& Result = Results[Index];
+		if (!Result.bSucceeded)
+		{
+			UE_LOG(LogUnrealPSKPSA, Error, TEXT("Failed to export %s to %s"), *GetNameSafe(Tasks[Index].Asset), *Tasks[Index].Filename);
+			continue;
+		}
+		
+		Stats.NumExported++;
+		Stats.TotalBytes += Result.BytesWritten;
+	}
+
+	UE_LOG(LogUnrealPSKPSA, Log, TEXT("Exported %d/%d assets in %.2fs (%.1f assets/s, %.1f MB/s)"),
+		Stats.NumExported, Stats.NumAssets, Stats.TotalSeconds, Stats.GetAssetsPerSecond(), Stats.GetMegabytesPerSecond());
+
+	if (OutStats != nullptr)
+	{
+		*OutStats = Stats;
+	}
+	
+	return Results;
+}
+
+TArray<FPskBatchExportResult> FPskBatchExporter::ExportToDirectory(const TArray<UObject*>& Assets, const FString& Directory, FPskBatchExportStats* OutStats)
+{
+	// assets from different folders may share a name, TSet compares case insensitively like the file system might
+	TArray<FPskBatchExportTask> Tasks;
+	TSet<FString> Filenames;
+	for (const auto Asset : Assets)
+	{
+		const auto Extension = FPskExporter::GetExtension(Asset);
+		if (Extension.IsEmpty()) continue;
+
+		auto Filename = FPaths::Combine(Directory, Asset->GetName() + "." + Extension);
+		for (auto Suffix = 1; Filenames.Contains(Filename); Suffix++)
+		{
+			Filename = FPaths::Combine(Directory, FString::Printf(TEXT("%s_%d.%s"), *Asset->GetName(), Suffix, *Extension));
+		}
+		Filenames.Add(Filename);
+
+		auto& Task = Tasks.AddDefaulted_GetRef();
+		Task.Asset = Asset;
+		Task.Filename = MoveTemp(Filename);
+	}
+	
+	return Export(Tasks, OutStats);
+}
@@ -0,0 +1,157 @@
+﻿#include "PskBatchImporter.h"
+
+#include "PskFactory.h"
+#include "PskImportData.h"
+#include "PskImportTransaction.h"
+#include "PskMaterialResolver.h"
+#include "PskxFactory.h"
+#include "UnrealPSKPSA.h"
+#include "Async/Async.h"
+#include "Dom/JsonObject.h"
+#include "Engine/StaticMesh.h"
+
+struct FPskBatchWork
+{
+	bool bIsStaticMesh = false;
+	bool bReadSucceeded = false;
+	
+	// Name_LOD0 files bring their Name_LODn siblings along, LOD0 first
+	TArray<FPskMeshImportData> SkeletalMeshLODs;
+	TArray<FPskxMeshImportData> StaticMeshLODs;
+};
+
+// the batch keeps one report per file it was given, lower LODs add their read stages and counters to it
+template <typename MeshDataType>
+static FPskImportReport TakeReport(TArray<MeshDataType>& LODs, const FString& Filename)
+{
+	FPskImportReport Report;
+	Report.Filename = Filename;
+	if (LODs.IsEmpty()) return Report;
+
+	Report = MoveTemp(LODs[0].Report);
+	for (auto LODIndex = 1; LODIndex < LODs.Num(); LODIndex++)
+	{
+		const auto& LODReport = LODs[LODIndex].Report;
+		Report.Timings.Accumulate(LODReport.Timings);
+		Report.Counters.Accumulate(LODReport.Counters);
+		Report.Memory.PeakBytes = FMath::Max(Report.Memory.PeakBytes, LODReport.Memory.PeakBytes);
+		Report.Memory.ImportDataBytes += LODReport.Memory.ImportDataBytes;
+	}
+	return Report;
+}
+
+TArray<FPskBatchImportResult> FPskBatchImporter::Import(const TArray<FPskBatchImportTask>& Tasks, const TMap<FString, FString>& MaterialNameToPathMap, const EObjectFlags Flags, FPskBatchImportStats* OutStats)
+{
+	check(IsInGameThread());
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskBatchImporter::Import);
+	
+	const auto StartTime = FPlatformTime::Seconds();
+	
+	// every asset of the batch is finalized once at the end, components are reregistered once
+	FPskImportTransaction Transaction;
+	FPskMaterialResolver MaterialResolver(MaterialNameToPathMap);
+	
+	TArray<FPskBatchImportResult> Results;
+	Results.SetNum(Tasks.Num());
+
+	TArray<TSharedPtr<FPskBatchWork>> Works;
+	TArray<TFuture<void>> Futures;
+	Works.SetNum(Tasks.Num());
+	Futures.SetNum(Tasks.Num());
+
+	// converted meshes wait for the game thread in memory, so only run a bounded number of files ahead of it
+	const auto MaxInFlight = FMath::Max(FTaskGraphInterface::Get().GetNumWorkerThreads() * 2, 2);
+	auto NextToLaunch = 0;
+	auto LaunchNext = [&]
+	{
+		const auto Index = NextToLaunch++;
+		const auto& Filename = Tasks[Index].Filename;
+		
+		const auto Work = MakeShared<FPskBatchWork>();
+		Work->bIsStaticMesh = FPaths::GetExtension(Filename).Equals("pskx");
+		Works[Index] = Work;
+		Futures[Index] = Async(EAsyncExecution::TaskGraph, [Work, Filename]
+		{
+			Work->bReadSucceeded = Work->bIsStaticMesh
+				? UPskxFactory::ReadMeshLODs(Filename, Work->StaticMeshLODs)
+				: UPskFactory::ReadMeshLODs(Filename, Work->SkeletalMeshLODs);
+		});
+	};
+
+	for (auto Index = 0; Index < Tasks.Num(); Index++)
+	{
+		while (NextToLaunch < Tasks.Num() && NextToLaunch - Index < MaxInFlight)
+		{
+			LaunchNext();
+		}
+
+		const auto& Task = Tasks[Index];
+		auto& Result = Results[Index];
+		
+		Futures[Index].Wait();
+		const auto Work = MoveTemp(Works[Index]);
+		if (!Work->bReadSucceeded)
+		{
+			UE_LOG(LogUnrealPSKPSA, Error, TEXT("Failed to read %s"), *Task.Filename);
+		}
+		else
+		{
+			Result.Asset = Work->bIsStaticMesh
+				? UPskxFactory::CreateMesh(Work->StaticMeshLODs, Task.Parent, Task.Name, Flags, MaterialResolver)
+				: UPskFactory::CreateMesh(Work->SkeletalMeshLODs, Task.Parent, Task.Name, Flags, MaterialResolver);
+		}
+		
+		// reports are finished once the transaction has built the static meshes
+		Result.Report = Work->bIsStaticMesh
+			? TakeReport(Work->StaticMeshLODs, Task.Filename)
+			: TakeReport(Work->SkeletalMeshLODs, Task.Filename);
+	}
+
+	MaterialResolver.Flush();
+	Transaction.Commit();
+
+	// the static meshes were built together, every one of them is charged an equal share so the file timings still
+	// add up to the batch
+	const auto NumStaticMeshes = Transaction.GetNumStaticMeshesBuilt();
+	const auto BuildSecondsPerStaticMesh = NumStaticMeshes > 0 ? Transaction.GetStaticMeshBuildSeconds() / NumStaticMeshes : 0.0;
+	for (auto Index = 0; Index < Tasks.Num(); Index++)
+	{
+		auto& Result = Results[Index];
+		if (const auto StaticMesh = Cast<UStaticMesh>(Result.Asset))
+		{
+			Result.Report.Timings.Build += BuildSecondsPerStaticMesh;
+			Result.Report.Timings.Create += BuildSecondsPerStaticMesh;
+			if (!StaticMesh->HasValidRenderData())
+			{
+				UE_LOG(LogUnrealPSKPSA, Error, TEXT("Failed to build %s from %s"), *StaticMesh->GetName(), *Tasks[Index].Filename);
+				Result.Asset = nullptr;
+			}
+		}
+		Result.Report.Finish(Result.Asset);
+	}
+
+	FPskBatchImportStats Stats;
+	Stats.NumFiles = Tasks.Num();
+	Stats.TotalSeconds = FPlatformTime::Seconds() - StartTime;
+	Stats.StaticMeshBuildSeconds = Transaction.GetStaticMeshBuildSeconds();
+	TArray<FPskImportReport> Reports;
+	for (const auto& Result : Results)
+	{
+		Stats.NumImported += Result.Asset != nullptr;
+		Stats.TotalBytes += Result.Report.Counters.BytesRead;
+		Reports.Add(Result.Report);
+	}
+
+	UE_LOG(LogUnrealPSKPSA, Log, TEXT("Imported %d/%d files in %.2fs (%.1f files/s, %.1f MB/s)"),
+		Stats.NumImported, Stats.NumFiles, Stats.TotalSeconds, Stats.GetFilesPerSecond(), Stats.GetMegabytesPerSecond());
+	const auto BatchJson = FPskImportReport::MakeBatchJson(Reports, Stats.TotalSeconds, false);
+	BatchJson->SetNumberField("static_mesh_build_seconds", Stats.StaticMeshBuildSeconds);
+	UE_LOG(LogUnrealPSKPSA, Log, TEXT("PskBatchImportReport: %s"), *FPskImportReport::ToJsonString(BatchJson));
+
+	if (OutStats != nullptr)
+	{
+		*OutStats = Stats;
+	}
+	
+	return Results;
+}
@@ -0,0 +1,659 @@
+﻿#include "PskExporter.h"
+
+#include "ActorXModels.h"
+#include "SkeletalMeshCompiler.h"
+#include "StaticMeshAttributes.h"
+#include "UnrealPSKPSA.h"
+#include "ActorXCore/ActorXWriter.h"
+#include "Animation/MorphTarget.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "Rendering/SkeletalMeshLODModel.h"
+#include "Rendering/SkeletalMeshModel.h"
+
+static_assert(sizeof(FVector3f) == ActorX::PackedSize::Point, "FVector3f must match the PNTS0000 layout");
+static_assert(sizeof(FVector2f) == ActorX::PackedSize::UV, "FVector2f must match the EXTRAUVS layout");
+static_assert(sizeof(VVertex) == ActorX::PackedSize::Wedge, "VVertex must match the VTXW0000 layout");
+static_assert(sizeof(VMaterial) == ActorX::PackedSize::Material, "VMaterial must match the MATT0000 layout");
+static_assert(sizeof(VRawBoneInfluence) == ActorX::PackedSize::Influence, "VRawBoneInfluence must match the RAWWEIGHTS layout");
+static_assert(sizeof(VMorphInfo) == ActorX::PackedSize::MorphInfo, "VMorphInfo must match the MRPHINFO layout");
+static_assert(sizeof(VMorphData) == ActorX::PackedSize::MorphData, "VMorphData must match the MRPHDATA layout");
+static_assert(sizeof(VAnimInfoBinary) == ActorX::PackedSize::AnimInfo, "VAnimInfoBinary must match the ANIMINFO layout");
+static_assert(sizeof(VScaleAnimKey) == ActorX::PackedSize::ScaleKey, "VScaleAnimKey must match the SCALEKEYS layout");
+
+// one array per chunk, in the on-disk layout. Bones and anim keys use the ActorX structs, FQuat4f may be padded
+struct FPskExportChunks
+{
+	TArray<FVector3f> Points;
+	TArray<VVertex> Wedges;
+	TArray<VTriangle> Faces;
+	TArray<VMaterial> Materials;
+	TArray<FVector3f> Normals;
+	TArray<FColor> VertexColors;
+	TArray<TArray<FVector2f>> ExtraUVs;
+	TArray<ActorX::NamedBone> Bones;
+	TArray<VRawBoneInfluence> Influences;
+	TArray<VMorphInfo> MorphInfos;
+	TArray<VMorphData> MorphDatas;
+	
+	TArray<VAnimInfoBinary> AnimInfos;
+	TArray<ActorX::QuatAnimKey> AnimKeys;
+	TArray<VScaleAnimKey> ScaleKeys;
+};
+
+// MIRROR_MESH, the inverse of what the importers apply
+static FVector3f Mirror(const FVector3f& Vector)
+{
+	return FVector3f(Vector.X, -Vector.Y, Vector.Z);
+}
+
+static FQuat4f Mirror(const FQuat4f& Quat)
+{
+	return FQuat4f(Quat.X, -Quat.Y, Quat.Z, Quat.W);
+}
+
+// psk colors are stored with red and blue the other way around
+static FColor SwapRedBlue(FColor Color)
+{
+	Swap(Color.R, Color.B);
+	return Color;
+}
+
+static void SetName(char* Out, const int32 Size, const FString& Name)
+{
+	FMemory::Memzero(Out, Size);
+	FCStringAnsi::Strncpy(Out, TCHAR_TO_ANSI(*Name), Size);
+}
+
+static void SetMaterial(VMaterial& Material, const FString& Name)
+{
+	FMemory::Memzero(Material);
+	SetName(Material.MaterialName, sizeof Material.MaterialName, Name);
+}
+
+static void GatherBones(const FReferenceSkeleton& RefSkeleton, TArray<ActorX::NamedBone>& OutBones)
+{
+	const auto& BoneInfos = RefSkeleton.GetRawRefBoneInfo();
+	const auto& BonePoses = RefSkeleton.GetRawRefBonePose();
+	
+	OutBones.SetNumZeroed(BoneInfos.Num());
+	for (auto BoneIndex = 0; BoneIndex < BoneInfos.Num(); BoneIndex++)
+	{
+		const auto& BoneInfo = BoneInfos[BoneIndex];
+		auto& Bone = OutBones[BoneIndex];
+		SetName(Bone.Name, sizeof Bone.Name, BoneInfo.Name.ToString());
+
+		// psk roots are their own parent
+		Bone.ParentIndex = FMath::Max(BoneInfo.ParentIndex, 0);
+		if (BoneInfo.ParentIndex != INDEX_NONE)
+		{
+			OutBones[BoneInfo.ParentIndex].NumChildren++;
+		}
+
+		const auto Position = Mirror(FVector3f(BonePoses[BoneIndex].GetLocation()));
+		const auto Orientation = Mirror(FQuat4f(BonePoses[BoneIndex].GetRotation()));
+		Bone.BonePos.Position = { Position.X, Position.Y, Position.Z };
+		Bone.BonePos.Orientation = { Orientation.X, Orientation.Y, Orientation.Z, Orientation.W };
+	}
+}
+
+static bool GatherSkeletalMesh(const USkeletalMesh* SkeletalMesh, FPskExportChunks& Out)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(GatherSkeletalMesh);
+	
+	const auto ImportedModel = SkeletalMesh->GetImportedModel();
+	if (ImportedModel == nullptr || ImportedModel->LODModels.IsEmpty()) return false;
+
+	const auto& LODModel = ImportedModel->LODModels[0];
+	const auto NumVertices = static_cast<int32>(LODModel.NumVertices);
+
+	// the index buffer addresses the vertices of every section back to back
+	TArray<int32> VertexSections;
+	VertexSections.SetNumUninitialized(NumVertices);
+	for (auto SectionIndex = 0; SectionIndex < LODModel.Sections.Num(); SectionIndex++)
+	{
+		const auto& Section = LODModel.Sections[SectionIndex];
+		for (auto i = 0; i < Section.NumVertices; i++)
+		{
+			VertexSections[Section.BaseVertexIndex + i] = SectionIndex;
+		}
+	}
+	
+	auto GetVertex = [&](const int32 VertexIndex) -> const FSoftSkinVertex&
+	{
+		const auto& Section = LODModel.Sections[VertexSections[VertexIndex]];
+		return Section.SoftVertices[VertexIndex - Section.BaseVertexIndex];
+	};
+
+	// vertices split at uv and normal seams are welded back into the points they were imported from
+	const auto& ImportMap = LODModel.MeshToImportVertexMap;
+	const auto bHasImportMap = ImportMap.Num() == NumVertices && LODModel.MaxImportVertex >= 0;
+	TArray<int32> ImportToPoint;
+	ImportToPoint.Init(INDEX_NONE, bHasImportMap ? LODModel.MaxImportVertex + 1 : NumVertices);
+	TArray<int32> VertexPoints;
+	TArray<int32> PointVertices;
+	VertexPoints.SetNumUninitialized(NumVertices);
+	PointVertices.Reserve(ImportToPoint.Num());
+	for (auto VertexIndex = 0; VertexIndex < NumVertices; VertexIndex++)
+	{
+		const auto ImportIndex = bHasImportMap ? ImportMap[VertexIndex] : VertexIndex;
+		if (!ImportToPoint.IsValidIndex(ImportIndex))
+		{
+			VertexPoints[VertexIndex] = PointVertices.Add(VertexIndex);
+			continue;
+		}
+		
+		auto& PointIndex = ImportToPoint[ImportIndex];
+		if (PointIndex == INDEX_NONE)
+		{
+			PointIndex = PointVertices.Add(VertexIndex);
+		}
+		VertexPoints[VertexIndex] = PointIndex;
+	}
+	
+	const auto NumPoints = PointVertices.Num();
+	Out.Points.SetNumUninitialized(NumPoints);
+	Out.Normals.SetNumUninitialized(NumPoints);
+	ParallelFor(NumPoints, [&](const int32 PointIndex)
+	{
+		const auto& Vertex = GetVertex(PointVertices[PointIndex]);
+		Out.Points[PointIndex] = Mirror(Vertex.Position);
+		Out.Normals[PointIndex] = Mirror(FVector3f(Vertex.TangentZ));
+	});
+
+	const auto NumExtraUVs = FMath::Max(static_cast<int32>(LODModel.NumTexCoords) - 1, 0);
+	Out.Wedges.SetNumUninitialized(NumVertices);
+	Out.VertexColors.SetNumUninitialized(NumVertices);
+	Out.ExtraUVs.SetNum(NumExtraUVs);
+	for (auto& UVs : Out.ExtraUVs)
+	{
+		UVs.SetNumUninitialized(NumVertices);
+	}
+	
+	ParallelFor(NumVertices, [&](const int32 VertexIndex)
+	{
+		const auto& Vertex = GetVertex(VertexIndex);
+		auto& Wedge = Out.Wedges[VertexIndex];
+		Wedge.PointIndex = VertexPoints[VertexIndex];
+		Wedge.U = Vertex.UVs[0].X;
+		Wedge.V = Vertex.UVs[0].Y;
+		Wedge.MatIndex = static_cast<char>(LODModel.Sections[VertexSections[VertexIndex]].MaterialIndex);
+		Wedge.Reserved = 0;
+		Wedge.Pad = 0;
+		
+		Out.VertexColors[VertexIndex] = SwapRedBlue(Vertex.Color);
+		for (auto UVIndex = 0; UVIndex < NumExtraUVs; UVIndex++)
+		{
+			Out.ExtraUVs[UVIndex][VertexIndex] = Vertex.UVs[UVIndex + 1];
+		}
+	});
+
+	// psk faces wind the other way around, corner k of the psk face is corner 2 - k of the engine triangle
+	Out.Faces.SetNumUninitialized(LODModel.IndexBuffer.Num() / 3);
+	for (const auto& Section : LODModel.Sections)
+	{
+		const auto FirstFace = static_cast<int32>(Section.BaseIndex / 3);
+		ParallelFor(static_cast<int32>(Section.NumTriangles), [&](const int32 TriangleIndex)
+		{
+			const auto FaceIndex = FirstFace + TriangleIndex;
+			auto& Face = Out.Faces[FaceIndex];
+			for (auto Corner = 0; Corner < 3; Corner++)
+			{
+				Face.WedgeIndex[Corner] = static_cast<int32>(LODModel.IndexBuffer[FaceIndex * 3 + 2 - Corner]);
+			}
+			Face.MatIndex = static_cast<char>(Section.MaterialIndex);
+			Face.AuxMatIndex = 0;
+			Face.SmoothingGroups = 0;
+		});
+	}
+
+	const auto& Materials = SkeletalMesh->GetMaterials();
+	Out.Materials.SetNumUninitialized(Materials.Num());
+	for (auto MaterialIndex = 0; MaterialIndex < Materials.Num(); MaterialIndex++)
+	{
+		const auto& Material = Materials[MaterialIndex];
+		SetMaterial(Out.Materials[MaterialIndex], Material.MaterialInterface != nullptr ? Material.MaterialInterface->GetName() : Material.ImportedMaterialSlotName.ToString());
+	}
+
+	GatherBones(SkeletalMesh->GetRefSkeleton(), Out.Bones);
+
+	// influences of a point come from the first vertex welded into it, bone indices are section local
+	TArray<int32> InfluenceOffsets;
+	InfluenceOffsets.SetNumZeroed(NumPoints + 1);
+	ParallelFor(NumPoints, [&](const int32 PointIndex)
+	{
+		const auto& Vertex = GetVertex(PointVertices[PointIndex]);
+		for (auto i = 0; i < MAX_TOTAL_INFLUENCES; i++)
+		{
+			InfluenceOffsets[PointIndex + 1] += Vertex.InfluenceWeights[i] > 0;
+		}
+	});
+	for (auto PointIndex = 0; PointIndex < NumPoints; PointIndex++)
+	{
+		InfluenceOffsets[PointIndex + 1] += InfluenceOffsets[PointIndex];
+	}
+	
+	Out.Influences.SetNumUninitialized(InfluenceOffsets.Last());
+	ParallelFor(NumPoints, [&](const int32 PointIndex)
+	{
+		const auto VertexIndex = PointVertices[PointIndex];
+		const auto& Vertex = GetVertex(VertexIndex);
+		const auto& BoneMap = LODModel.Sections[VertexSections[VertexIndex]].BoneMap;
+
+		auto TotalWeight = 0.0f;
+		for (auto i = 0; i < MAX_TOTAL_INFLUENCES; i++)
+		{
+			TotalWeight += Vertex.InfluenceWeights[i];
+		}
+
+		auto InfluenceIndex = InfluenceOffsets[PointIndex];
+		for (auto i = 0; i < MAX_TOTAL_INFLUENCES; i++)
+		{
+			if (Vertex.InfluenceWeights[i] == 0) continue;
+			
+			auto& Influence = Out.Influences[InfluenceIndex++];
+			Influence.Weight = Vertex.InfluenceWeights[i] / TotalWeight;
+			Influence.PointIdx = PointIndex;
+			Influence.BoneIdx = BoneMap.IsValidIndex(Vertex.InfluenceBones[i]) ? BoneMap[Vertex.InfluenceBones[i]] : 0;
+		}
+	});
+
+	// every target keeps one delta per point, runs are concatenated in target order
+	const auto& MorphTargets = SkeletalMesh->GetMorphTargets();
+	TArray<TArray<VMorphData>> TargetDatas;
+	TargetDatas.SetNum(MorphTargets.Num());
+	ParallelFor(MorphTargets.Num(), [&](const int32 TargetIndex)
+	{
+		const auto MorphTarget = MorphTargets[TargetIndex];
+		if (MorphTarget == nullptr || MorphTarget->GetMorphLODModels().IsEmpty()) return;
+
+		TBitArray<> VisitedPoints(false, NumPoints);
+		for (const auto& Delta : MorphTarget->GetMorphLODModels()[0].Vertices)
+		{
+			const auto VertexIndex = static_cast<int32>(Delta.SourceIdx);
+			if (!VertexPoints.IsValidIndex(VertexIndex)) continue;
+
+			const auto PointIndex = VertexPoints[VertexIndex];
+			if (VisitedPoints[PointIndex]) continue;
+			VisitedPoints[PointIndex] = true;
+
+			auto& Data = TargetDatas[TargetIndex].AddDefaulted_GetRef();
+			Data.PositionDelta = Mirror(Delta.PositionDelta);
+			Data.TangentZDelta = Mirror(Delta.TangentZDelta);
+			Data.PointIdx = PointIndex;
+		}
+	});
+
+	for (auto TargetIndex = 0; TargetIndex < MorphTargets.Num(); TargetIndex++)
+	{
+		if (TargetDatas[TargetIndex].IsEmpty()) continue;
+		
+		auto& Info = Out.MorphInfos.AddZeroed_GetRef();
+		SetName(Info.Name, sizeof Info.Name, MorphTargets[TargetIndex]->GetName());
+		Info.VertexCount = TargetDatas[TargetIndex].Num();
+		Out.MorphDatas.Append(MoveTemp(TargetDatas[TargetIndex]));
+	}
+	
+	return true;
+}
+
+static bool GatherStaticMesh(const UStaticMesh* StaticMesh, FPskExportChunks& Out)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(GatherStaticMesh);
+	
+	if (!StaticMesh->IsSourceModelValid(0)) return false;
+
+	const auto MeshDescription = StaticMesh->GetSourceModel(0).GetCachedMeshDescription();
+	if (MeshDescription == nullptr) return false;
+
+	const auto& Mesh = *MeshDescription;
+	const FStaticMeshConstAttributes Attributes(Mesh);
+	const auto VertexPositions = Attributes.GetVertexPositions();
+	const auto InstanceNormals = Attributes.GetVertexInstanceNormals();
+	const auto InstanceUVs = Attributes.GetVertexInstanceUVs();
+	const auto InstanceColors = Attributes.GetVertexInstanceColors();
+	const auto SlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+
+	// element ids may have holes left by edits, chunks are dense
+	TArray<FVertexID> VertexIDs;
+	TArray<int32> VertexRemap;
+	VertexRemap.SetNumUninitialized(Mesh.Vertices().GetArraySize());
+	for (const auto VertexID : Mesh.Vertices().GetElementIDs())
+	{
+		VertexRemap[VertexID.GetValue()] = VertexIDs.Add(VertexID);
+	}
+
+	TArray<FVertexInstanceID> InstanceIDs;
+	TArray<int32> InstanceRemap;
+	InstanceRemap.SetNumUninitialized(Mesh.VertexInstances().GetArraySize());
+	for (const auto InstanceID : Mesh.VertexInstances().GetElementIDs())
+	{
+		InstanceRemap[InstanceID.GetValue()] = InstanceIDs.Add(InstanceID);
+	}
+
+	TArray<FTriangleID> TriangleIDs;
+	TriangleIDs.Reserve(Mesh.Triangles().Num());
+	for (const auto TriangleID : Mesh.Triangles().GetElementIDs())
+	{
+		TriangleIDs.Add(TriangleID);
+	}
+
+	const auto& StaticMaterials = StaticMesh->GetStaticMaterials();
+	Out.Materials.SetNumUninitialized(StaticMaterials.Num());
+	for (auto MaterialIndex = 0; MaterialIndex < StaticMaterials.Num(); MaterialIndex++)
+	{
+		const auto& Material = StaticMaterials[MaterialIndex];
+		SetMaterial(Out.Materials[MaterialIndex], Material.MaterialInterface != nullptr ? Material.MaterialInterface->GetName() : Material.ImportedMaterialSlotName.ToString());
+	}
+	
+	// polygon groups reference materials by slot name, groups without a matching slot fall back to their own index
+	TArray<int32> GroupMaterials;
+	GroupMaterials.SetNumZeroed(Mesh.PolygonGroups().GetArraySize());
+	auto GroupIndex = 0;
+	for (const auto GroupID : Mesh.PolygonGroups().GetElementIDs())
+	{
+		const auto MaterialIndex = StaticMesh->GetMaterialIndex(SlotNames[GroupID]);
+		GroupMaterials[GroupID.GetValue()] = MaterialIndex != INDEX_NONE ? MaterialIndex : FMath::Min(GroupIndex, FMath::Max(StaticMaterials.Num() - 1, 0));
+		GroupIndex++;
+	}
+
+	Out.Points.SetNumUninitialized(VertexIDs.Num());
+	Out.Normals.SetNumUninitialized(VertexIDs.Num());
+	ParallelFor(VertexIDs.Num(), [&](const int32 PointIndex)
+	{
+		const auto VertexID = VertexIDs[PointIndex];
+		const auto VertexInstances = Mesh.GetVertexVertexInstanceIDs(VertexID);
+		Out.Points[PointIndex] = Mirror(VertexPositions[VertexID]);
+		Out.Normals[PointIndex] = VertexInstances.Num() > 0 ? Mirror(InstanceNormals[VertexInstances[0]]) : FVector3f::ZeroVector;
+	});
+
+	const auto NumWedges = InstanceIDs.Num();
+	const auto NumExtraUVs = FMath::Max(InstanceUVs.GetNumChannels() - 1, 0);
+	Out.Wedges.SetNumUninitialized(NumWedges);
+	Out.VertexColors.SetNumUninitialized(NumWedges);
+	Out.ExtraUVs.SetNum(NumExtraUVs);
+	for (auto& UVs : Out.ExtraUVs)
+	{
+		UVs.SetNumUninitialized(NumWedges);
+	}
+	
+	ParallelFor(NumWedges, [&](const int32 WedgeIndex)
+	{
+		const auto InstanceID = InstanceIDs[WedgeIndex];
+		const auto Triangles = Mesh.GetVertexInstanceConnectedTriangleIDs(InstanceID);
+		const auto UV = InstanceUVs.GetNumChannels() > 0 ? InstanceUVs.Get(InstanceID, 0) : FVector2f::ZeroVector;
+		
+		auto& Wedge = Out.Wedges[WedgeIndex];
+		Wedge.PointIndex = VertexRemap[Mesh.GetVertexInstanceVertex(InstanceID).GetValue()];
+		Wedge.U = UV.X;
+		Wedge.V = UV.Y;
+		Wedge.MatIndex = static_cast<char>(Triangles.Num() > 0 ? GroupMaterials[Mesh.GetTrianglePolygonGroup(Triangles[0]).GetValue()] : 0);
+		Wedge.Reserved = 0;
+		Wedge.Pad = 0;
+
+		const auto& Color = InstanceColors[InstanceID];
+		Out.VertexColors[WedgeIndex] = SwapRedBlue(FLinearColor(Color.X, Color.Y, Color.Z, Color.W).ToFColor(true));
+		for (auto UVIndex = 0; UVIndex < NumExtraUVs; UVIndex++)
+		{
+			Out.ExtraUVs[UVIndex][WedgeIndex] = InstanceUVs.Get(InstanceID, UVIndex + 1);
+		}
+	});
+
+	// psk faces wind the other way around, corner k of the psk face is corner 2 - k of the engine triangle
+	Out.Faces.SetNumUninitialized(TriangleIDs.Num());
+	ParallelFor(TriangleIDs.Num(), [&](const int32 FaceIndex)
+	{
+		const auto TriangleID = TriangleIDs[FaceIndex];
+		const auto TriangleInstances = Mesh.GetTriangleVertexInstances(TriangleID);
+		
+		auto& Face = Out.Faces[FaceIndex];
+		for (auto Corner = 0; Corner < 3; Corner++)
+		{
+			Face.WedgeIndex[Corner] = InstanceRemap[TriangleInstances[2 - Corner].GetValue()];
+		}
+		Face.MatIndex = static_cast<char>(GroupMaterials[Mesh.GetTrianglePolygonGroup(TriangleID).GetValue()]);
+		Face.AuxMatIndex = 0;
+		Face.SmoothingGroups = 0;
+	});
+	
+	return true;
+}
+
+static bool GatherAnimSequence(const UAnimSequence* AnimSequence, FPskExportChunks& Out)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(GatherAnimSequence);
+	
+	const auto Skeleton = AnimSequence->GetSkeleton();
+	const auto DataModel = AnimSequence->GetDataModel();
+	if (Skeleton == nullptr || DataModel == nullptr) return false;
+
+	const auto& RefSkeleton = Skeleton->GetReferenceSkeleton();
+	GatherBones(RefSkeleton, Out.Bones);
+
+	const auto NumBones = Out.Bones.Num();
+	const auto NumFrames = FMath::Max(DataModel->GetNumberOfKeys(), 1);
+
+	// bones without a track hold their reference pose on every frame, the model is only queried on this thread
+	TArray<FName> TrackNames;
+	DataModel->GetBoneTrackNames(TrackNames);
+	TArray<TArray<FTransform>> BoneTransforms;
+	BoneTransforms.SetNum(NumBones);
+	for (const auto& TrackName : TrackNames)
+	{
+		const auto BoneIndex = RefSkeleton.FindRawBoneIndex(TrackName);
+		if (BoneIndex != INDEX_NONE)
+		{
+			DataModel->GetBoneTrackTransforms(TrackName, BoneTransforms[BoneIndex]);
+		}
+	}
+
+	auto& Info = Out.AnimInfos.AddZeroed_GetRef();
+	SetName(Info.Name, sizeof Info.Name, AnimSequence->GetName());
+	SetName(Info.Group, sizeof Info.Group, "None");
+	Info.TotalBones = NumBones;
+	Info.KeyQuotum = NumBones * NumFrames;
+	Info.KeyReduction = 1.0f;
+	Info.TrackTime = NumFrames;
+	Info.AnimRate = DataModel->GetFrameRate().AsDecimal();
+	Info.NumRawFrames = NumFrames;
+
+	// keys are frame major, every bone fills its own column
+	const auto& BonePoses = RefSkeleton.GetRawRefBonePose();
+	TArray<bool> ScaledBones;
+	ScaledBones.SetNumZeroed(NumBones);
+	Out.AnimKeys.SetNumUninitialized(NumBones * NumFrames);
+	Out.ScaleKeys.SetNumUninitialized(NumBones * NumFrames);
+	ParallelFor(NumBones, [&](const int32 BoneIndex)
+	{
+		const auto& Transforms = BoneTransforms[BoneIndex];
+		for (auto Frame = 0; Frame < NumFrames; Frame++)
+		{
+			const auto& Transform = Transforms.IsEmpty() ? BonePoses[BoneIndex] : Transforms[FMath::Min(Frame, Transforms.Num() - 1)];
+			auto Position = FVector3f(Transform.GetLocation());
+			auto Orientation = FQuat4f(Transform.GetRotation());
+			const auto Scale = FVector3f(Transform.GetScale3D());
+			Position = Mirror(Position);
+			Orientation = Mirror(Orientation);
+
+			const auto KeyIndex = Frame * NumBones + BoneIndex;
+			auto& Key = Out.AnimKeys[KeyIndex];
+			Key.Position = { Position.X, Position.Y, Position.Z };
+			Key.Orientation = { Orientation.X, Orientation.Y, Orientation.Z, Orientation.W };
+			Key.Time = 1.0f;
+
+			Out.ScaleKeys[KeyIndex] = { Scale, 1.0f };
+			ScaledBones[BoneIndex] |= !Scale.Equals(FVector3f::OneVector);
+		}
+	});
+
+	// SCALEKEYS is optional, only written when some bone actually scales
+	if (!ScaledBones.Contains(true))
+	{
+		Out.ScaleKeys.Empty();
+	}
+	
+	return true;
+}
+
+template <typename T>
+static void WriteChunk(ActorX::ChunkWriter& Writer, const char* ChunkName, const TArray<T>& Elements)
+{
+	Writer.WriteChunk(ChunkName, Elements.GetData(), sizeof(T), Elements.Num());
+}
+
+template <typename T>
+static void WriteOptionalChunk(ActorX::ChunkWriter& Writer, const char* ChunkName, const TArray<T>& Elements)
+{
+	if (Elements.IsEmpty()) return;
+	
+	WriteChunk(Writer, ChunkName, Elements);
+}
+
+template <typename T>
+static int64 GetChunkSize(const TArray<T>& Elements)
+{
+	return sizeof(ActorX::ChunkHeader) + Elements.Num() * static_cast<int64>(sizeof(T));
+}
+
+static void WriteMesh(const FPskExportChunks& Chunks, const bool bIsStaticMesh, ActorX::ChunkWriter& Writer)
+{
+	auto Size = GetChunkSize(Chunks.Points) + GetChunkSize(Chunks.Wedges) + GetChunkSize(Chunks.Faces) + GetChunkSize(Chunks.Materials)
+		+ GetChunkSize(Chunks.Bones) + GetChunkSize(Chunks.Influences) + GetChunkSize(Chunks.Normals) + GetChunkSize(Chunks.VertexColors)
+		+ GetChunkSize(Chunks.MorphInfos) + GetChunkSize(Chunks.MorphDatas);
+	for (const auto& UVs : Chunks.ExtraUVs)
+	{
+		Size += GetChunkSize(UVs);
+	}
+	Writer.GetBuffer().reserve(Writer.GetBuffer().size() + Size);
+	
+	WriteChunk(Writer, "PNTS0000", Chunks.Points);
+	WriteChunk(Writer, "VTXW0000", Chunks.Wedges);
+	Writer.WriteFaces(Chunks.Faces.GetData(), Chunks.Faces.Num(), Chunks.Wedges.Num());
+	WriteChunk(Writer, "MATT0000", Chunks.Materials);
+	
+	// static meshes have no skeleton, the chunks are left out rather than written empty
+	if (!bIsStaticMesh)
+	{
+		WriteChunk(Writer, "REFSKELT", Chunks.Bones);
+		WriteChunk(Writer, "RAWWEIGHTS", Chunks.Influences);
+	}
+	
+	WriteOptionalChunk(Writer, "VTXNORMS", Chunks.Normals);
+	WriteOptionalChunk(Writer, "VERTEXCOLOR", Chunks.VertexColors);
+	for (const auto& UVs : Chunks.ExtraUVs)
+	{
+		WriteChunk(Writer, "EXTRAUVS", UVs);
+	}
+	WriteOptionalChunk(Writer, "MRPHINFO", Chunks.MorphInfos);
+	WriteOptionalChunk(Writer, "MRPHDATA", Chunks.MorphDatas);
+}
+
+static void WriteAnimation(const FPskExportChunks& Chunks, ActorX::ChunkWriter& Writer)
+{
+	Writer.GetBuffer().reserve(Writer.GetBuffer().size() + GetChunkSize(Chunks.Bones) + GetChunkSize(Chunks.AnimInfos)
+		+ GetChunkSize(Chunks.AnimKeys) + GetChunkSize(Chunks.ScaleKeys));
+	
+	WriteChunk(Writer, "BONENAMES", Chunks.Bones);
+	WriteChunk(Writer, "ANIMINFO", Chunks.AnimInfos);
+	WriteChunk(Writer, "ANIMKEYS", Chunks.AnimKeys);
+	WriteOptionalChunk(Writer, "SCALEKEYS", Chunks.ScaleKeys);
+}
+
+FString FPskExporter::GetExtension(const UObject* Asset)
+{
+	if (Asset == nullptr) return FString();
+	if (Asset->IsA<USkeletalMesh>()) return "psk";
+	if (Asset->IsA<UStaticMesh>()) return "pskx";
+	if (Asset->IsA<UAnimSequence>()) return "psa";
+	return FString();
+}
+
+bool FPskExporter::Prepare(UObject* Asset)
+{
+	check(IsInGameThread());
+	
+	if (const auto SkeletalMesh = Cast<USkeletalMesh>(Asset))
+	{
+		// an async build rewrites the imported model in place
+		if (SkeletalMesh->IsCompiling())
+		{
+			FSkeletalMeshCompilingManager::Get().FinishCompilation({ SkeletalMesh });
+		}
+		return SkeletalMesh->GetImportedModel() != nullptr && !SkeletalMesh->GetImportedModel()->LODModels.IsEmpty();
+	}
+	
+	if (const auto StaticMesh = Cast<UStaticMesh>(Asset))
+	{
+		// loads the mesh description from bulk data, workers only read the cached copy
+		return StaticMesh->GetMeshDescription(0) != nullptr;
+	}
+	
+	if (const auto AnimSequence = Cast<UAnimSequence>(Asset))
+	{
+		return AnimSequence->GetSkeleton() != nullptr && AnimSequence->GetDataModel() != nullptr;
+	}
+	
+	return false;
+}
+
+bool FPskExporter::Export(const UObject* Asset, FArchive& Ar)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskExporter::Export);
+
+	FPskExportChunks Chunks;
+	TUniquePtr<ActorX::ChunkWriter> Writer;
+	if (const auto SkeletalMesh = Cast<USkeletalMesh>(Asset))
+	{
+		if (!GatherSkeletalMesh(SkeletalMesh, Chunks)) return false;
+		
+		Writer = MakeUnique<ActorX::ChunkWriter>("ACTRHEAD");
+		WriteMesh(Chunks, false, *Writer);
+	}
+	else if (const auto StaticMesh = Cast<UStaticMesh>(Asset))
+	{
+		if (!GatherStaticMesh(StaticMesh, Chunks)) return false;
+		
+		Writer = MakeUnique<ActorX::ChunkWriter>("ACTRHEAD");
+		WriteMesh(Chunks, true, *Writer);
+	}
+	else if (const auto AnimSequence = Cast<UAnimSequence>(Asset))
+	{
+		if (!GatherAnimSequence(AnimSequence, Chunks)) return false;
+		
+		Writer = MakeUnique<ActorX::ChunkWriter>("ANIMHEAD");
+		WriteAnimation(Chunks, *Writer);
+	}
+	else
+	{
+		return false;
+	}
+
+	// the chunks were laid out back to back in memory, the file is one write
+	auto& Buffer = Writer->GetBuffer();
+	Ar.Serialize(Buffer.data(), Buffer.size());
+	return !Ar.IsError();
+}
+
+bool FPskExporter::ExportToFile(const UObject* Asset, const FString& Filename, int64* OutBytes)
+{
+	const TUniquePtr<FArchive> Ar(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Ar.IsValid())
+	{
+		UE_LOG(LogUnrealPSKPSA, Error, TEXT("Could not open %s for writing"), *Filename);
+		return false;
+	}
+
+	auto bSucceeded = Export(Asset, *Ar);
+	if (OutBytes != nullptr)
+	{
+		*OutBytes = Ar->Tell();
+	}
+	
+	bSucceeded &= Ar->Close();
+	if (!bSucceeded)
+	{
+		IFileManager::Get().Delete(*Filename);
+	}
+	
+	return bSucceeded;
+}
@@ -1,90 +1,341 @@
 #include "PskFactory.h"
 
 #include "IMeshBuilderModule.h"
+#include "PskAssetImportData.h"
+#include "PskAsyncImport.h"
+#include "PskImportData.h"
+#include "PskImportDataCache.h"
+#include "PskImportTransaction.h"
+#include "PskMaterialResolver.h"
+#include "PskMeshConverter.h"
 #include "PskPsaUtils.h"
 #include "PskReader.h"
+#include "PskSkeletonCache.h"
+#include "UnrealPSKPSA.h"
+#include "Animation/MorphTarget.h"
 #include "AssetRegistry/AssetRegistryModule.h"
-#include "Materials/MaterialInstanceConstant.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Hash/CityHash.h"
 #include "Rendering/SkeletalMeshLODImporterData.h"
 #include "Rendering/SkeletalMeshLODModel.h"
 #include "Rendering/SkeletalMeshModel.h"
 
-UObject* UPskFactory::Import(const FString& Filename, UObject* Parent, const FName Name, const EObjectFlags Flags, TMap<FString, FString> MaterialNameToPathMap)
+// deltas this small are export noise, they only cost memory and morph evaluation time
+constexpr float MorphDeltaThreshold = 1.e-4f;
+
+static TAutoConsoleVariable<int32> CVarPskMaxBoneInfluences(
+	TEXT("psk.MaxBoneInfluences"),
+	8,
+	TEXT("Most bone influences a psk point keeps on import, usually 4, 8 or 12. Weaker influences are dropped and the rest renormalized."));
+
+/*
+ * Builds morph targets against the sections of a built LOD. Morph data references psk points, which the build may
+ * have split into several render vertices along uv and normal seams, so the point to vertex mapping is inverted once
+ * and shared by every target, which are then populated in parallel. Lower LODs add their deltas to the targets of
+ * the same name. The caller rebuilds render data once every LOD has been added.
+ */
+static void CreateMorphTargets(const TArray<VMorphInfo>& MorphInfos, const TArray<VMorphData>& MorphDatas, USkeletalMesh* SkeletalMesh, const int32 LODIndex)
 {
-	auto Data = FPskReader(Filename);
-	if (!Data.bIsValid) return nullptr;
+	const auto& LODModel = SkeletalMesh->GetImportedModel()->LODModels[LODIndex];
+	const auto& MeshToImportVertexMap = LODModel.MeshToImportVertexMap;
+	if (MeshToImportVertexMap.IsEmpty())
+	{
+		UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s: the built mesh has no import vertex map, skipping morph targets"), *SkeletalMesh->GetName());
+		return;
+	}
+
+	auto NumPoints = 0;
+	for (const auto PointIndex : MeshToImportVertexMap)
+	{
+		NumPoints = FMath::Max(NumPoints, PointIndex + 1);
+	}
 
-	TArray<FColor> VertexColorsByPoint;
-	VertexColorsByPoint.Init(FColor::Black, Data.VertexColors.Num());
-	if (Data.bHasVertexColors)
+	// render vertices of point i are PointVertices[PointVertexOffsets[i]] up to PointVertices[PointVertexOffsets[i + 1]]
+	TArray<int32> PointVertexOffsets;
+	PointVertexOffsets.SetNumZeroed(NumPoints + 1);
+	for (const auto PointIndex : MeshToImportVertexMap)
 	{
-		for (auto i = 0; i < Data.Wedges.Num(); i++)
+		if (PointIndex >= 0)
 		{
-			auto FixedColor = Data.VertexColors[i];
-			Swap(FixedColor.R, FixedColor.B);
-			VertexColorsByPoint[Data.Wedges[i].PointIndex] = FixedColor;
+			PointVertexOffsets[PointIndex + 1]++;
 		}
 	}
+	for (auto i = 0; i < NumPoints; i++)
+	{
+		PointVertexOffsets[i + 1] += PointVertexOffsets[i];
+	}
 	
-	FSkeletalMeshImportData SkeletalMeshImportData;
-
-	for (auto i = 0; i < Data.Normals.Num(); i++)
+	TArray<int32> PointVertices;
+	PointVertices.SetNumUninitialized(PointVertexOffsets.Last());
+	auto NextVertex = PointVertexOffsets;
+	for (auto VertexIndex = 0; VertexIndex < MeshToImportVertexMap.Num(); VertexIndex++)
 	{
-		Data.Normals[i].Y = -Data.Normals[i].Y; // MIRROR_MESH
+		const auto PointIndex = MeshToImportVertexMap[VertexIndex];
+		if (PointIndex >= 0)
+		{
+			PointVertices[NextVertex[PointIndex]++] = VertexIndex;
+		}
 	}
 
-	for (auto Vertex : Data.Vertices)
+	// morph datas are stored back to back, one run per morph info
+	TArray<int32> DataOffsets;
+	DataOffsets.Reserve(MorphInfos.Num());
+	auto DataPosition = 0;
+	for (const auto& Info : MorphInfos)
 	{
-		auto FixedVertex = Vertex;
-		FixedVertex.Y = -FixedVertex.Y; // MIRROR_MESH
-		SkeletalMeshImportData.Points.Add(FixedVertex);
-		SkeletalMeshImportData.PointToRawMap.Add(SkeletalMeshImportData.Points.Num()-1);
+		if (Info.VertexCount < 0 || DataPosition + Info.VertexCount > MorphDatas.Num())
+		{
+			UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s: morph target runs past the end of MRPHDATA, skipping it and every target after it"), ANSI_TO_TCHAR(Info.Name));
+			break;
+		}
+		DataOffsets.Add(DataPosition);
+		DataPosition += Info.VertexCount;
 	}
-	
-	auto WindingOrder = {2, 1, 0};
-	for (const auto PskFace : Data.Faces)
-	{
-		SkeletalMeshImportData::FTriangle Face;
-		Face.MatIndex = PskFace.MatIndex;
-		Face.SmoothingGroups = 1;
-		Face.AuxMatIndex = 0;
 
-		for (auto VertexIndex : WindingOrder)
+	// objects have to be created on the game thread, only the deltas are built in parallel
+	TArray<UMorphTarget*> MorphTargets;
+	TArray<UMorphTarget*> NewMorphTargets;
+	TSet<FName> UsedNames;
+	MorphTargets.Reserve(DataOffsets.Num());
+	for (auto TargetIndex = 0; TargetIndex < DataOffsets.Num(); TargetIndex++)
+	{
+		auto TargetName = FName(MorphInfos[TargetIndex].Name);
+		auto MorphTarget = LODIndex > 0 && !UsedNames.Contains(TargetName) ? FindObjectFast<UMorphTarget>(SkeletalMesh, TargetName) : nullptr;
+		if (MorphTarget == nullptr)
 		{
-			const auto WedgeIndex = PskFace.WedgeIndex[VertexIndex];
-			const auto PskWedge = Data.Wedges[WedgeIndex];
-			
-			SkeletalMeshImportData::FVertex Wedge;
-			Wedge.MatIndex = PskWedge.MatIndex;
-			Wedge.VertexIndex = PskWedge.PointIndex;
-			Wedge.Color = Data.bHasVertexColors ? VertexColorsByPoint[PskWedge.PointIndex] : FColor::Black;
-			Wedge.UVs[0] = FVector2f(PskWedge.U, PskWedge.V);
-			for (auto UVIdx = 0; UVIdx < Data.ExtraUVs.Num(); UVIdx++)
+			if (FindObjectFast<UMorphTarget>(SkeletalMesh, TargetName) != nullptr)
 			{
-				auto UV =  Data.ExtraUVs[UVIdx][PskFace.WedgeIndex[VertexIndex]];
-				Wedge.UVs[UVIdx+1] = UV;
+				TargetName = MakeUniqueObjectName(SkeletalMesh, UMorphTarget::StaticClass(), TargetName);
 			}
 			
-			Face.WedgeIndex[VertexIndex] = SkeletalMeshImportData.Wedges.Add(Wedge);
-			Face.TangentZ[VertexIndex] = Data.bHasVertexNormals ? Data.Normals[PskWedge.PointIndex] : FVector3f::ZeroVector;
-			Face.TangentY[VertexIndex] = FVector3f::ZeroVector;
-			Face.TangentX[VertexIndex] = FVector3f::ZeroVector;
+			MorphTarget = NewObject<UMorphTarget>(SkeletalMesh, TargetName);
+			MorphTarget->BaseSkelMesh = SkeletalMesh;
+			NewMorphTargets.Add(MorphTarget);
+		}
+		UsedNames.Add(TargetName);
+		MorphTargets.Add(MorphTarget);
+	}
+
+	ParallelFor(MorphTargets.Num(), [&](const int32 TargetIndex)
+	{
+		const auto DataOffset = DataOffsets[TargetIndex];
+		const auto VertexCount = MorphInfos[TargetIndex].VertexCount;
+		
+		TArray<FMorphTargetDelta> Deltas;
+		Deltas.Reserve(VertexCount);
+		for (auto i = DataOffset; i < DataOffset + VertexCount; i++)
+		{
+			const auto& MorphData = MorphDatas[i];
+			const FVector3f PositionDelta(MorphData.PositionDelta.X, -MorphData.PositionDelta.Y, MorphData.PositionDelta.Z); // MIRROR_MESH
+			const FVector3f TangentZDelta(MorphData.TangentZDelta.X, -MorphData.TangentZDelta.Y, MorphData.TangentZDelta.Z);
+			if (PositionDelta.SizeSquared() < FMath::Square(MorphDeltaThreshold) && TangentZDelta.SizeSquared() < FMath::Square(MorphDeltaThreshold)) continue;
+			if (MorphData.PointIdx < 0 || MorphData.PointIdx >= NumPoints) continue;
+
+			for (auto j = PointVertexOffsets[MorphData.PointIdx]; j < PointVertexOffsets[MorphData.PointIdx + 1]; j++)
+			{
+				auto& Delta = Deltas.AddDefaulted_GetRef();
+				Delta.PositionDelta = PositionDelta;
+				Delta.TangentZDelta = TangentZDelta;
+				Delta.SourceIdx = PointVertices[j];
+			}
+		}
+		
+		MorphTargets[TargetIndex]->PopulateDeltas(Deltas, LODIndex, LODModel.Sections);
+	});
+
+	SkeletalMesh->GetMorphTargets().Append(NewMorphTargets);
+}
+
+// skins a lower LOD to the bones of LOD0 by bone name, false if it uses a bone LOD0 does not have
+static bool RemapLODBones(FSkeletalMeshImportData& LODImportData, const FSkeletalMeshImportData& BaseImportData)
+{
+	TMap<FString, int32> BaseBoneIndexByName;
+	for (auto BoneIndex = 0; BoneIndex < BaseImportData.RefBonesBinary.Num(); BoneIndex++)
+	{
+		BaseBoneIndexByName.Add(BaseImportData.RefBonesBinary[BoneIndex].Name, BoneIndex);
+	}
+
+	TArray<int32> BoneRemap;
+	for (const auto& Bone : LODImportData.RefBonesBinary)
+	{
+		const auto BaseBoneIndex = BaseBoneIndexByName.Find(Bone.Name);
+		if (BaseBoneIndex == nullptr)
+		{
+			UE_LOG(LogUnrealPSKPSA, Warning, TEXT("Bone %s is not part of LOD0"), *Bone.Name);
+			return false;
+		}
+		BoneRemap.Add(*BaseBoneIndex);
+	}
+
+	for (auto& Influence : LODImportData.Influences)
+	{
+		Influence.BoneIndex = BoneRemap[Influence.BoneIndex];
+	}
+	LODImportData.RefBonesBinary = BaseImportData.RefBonesBinary;
+	return true;
+}
+
+// points the faces of a lower LOD at the material list of the mesh, appending the materials LOD0 does not use
+static void MergeLODMaterials(FSkeletalMeshImportData& LODImportData, TArray<SkeletalMeshImportData::FMaterial>& MeshMaterials)
+{
+	TArray<int32> MaterialRemap;
+	for (const auto& Material : LODImportData.Materials)
+	{
+		auto MaterialIndex = MeshMaterials.IndexOfByPredicate([&Material](const SkeletalMeshImportData::FMaterial& MeshMaterial)
+		{
+			return MeshMaterial.MaterialImportName == Material.MaterialImportName;
+		});
+		if (MaterialIndex == INDEX_NONE)
+		{
+			MaterialIndex = MeshMaterials.Add(Material);
+		}
+		MaterialRemap.Add(MaterialIndex);
+	}
+
+	for (auto& Face : LODImportData.Faces)
+	{
+		Face.MatIndex = static_cast<uint16>(MaterialRemap.IsValidIndex(Face.MatIndex) ? MaterialRemap[Face.MatIndex] : 0);
+	}
+}
+
+UObject* UPskFactory::Import(const FString& Filename, UObject* Parent, const FName Name, const EObjectFlags Flags, TMap<FString, FString> MaterialNameToPathMap, USkeletalMesh* ExistingMesh)
+{
+	TArray<FPskMeshImportData> LODs;
+	if (!ReadMeshLODs(Filename, LODs))
+	{
+		FinishReports(LODs, nullptr);
+		return nullptr;
+	}
+
+	FPskMaterialResolver MaterialResolver(MaterialNameToPathMap);
+	const auto SkeletalMesh = CreateMesh(LODs, Parent, Name, Flags, MaterialResolver, ExistingMesh);
+	FinishReports(LODs, SkeletalMesh);
+	return SkeletalMesh;
+}
+
+UObject* UPskFactory::FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Params, FFeedbackContext* Warn, bool& bOutOperationCanceled)
+{
+	const auto Name = FName(*InName.ToString().Replace(TEXT("_LOD0"), TEXT("")));
+	
+	// read, convert and create
+	FScopedSlowTask SlowTask(3, FText::Format(NSLOCTEXT("UnrealPSKPSA", "ImportingFile", "Importing {0}"), FText::FromName(Name)), true, Warn != nullptr ? *Warn : *GWarn);
+	SlowTask.MakeDialog(true);
+	
+	TArray<FPskMeshImportData> LODs;
+	if (!FPskAsyncImport::ReadMesh(SlowTask, Filename, LODs, &ReadMeshLODs, bOutOperationCanceled))
+	{
+		FinishReports(LODs, nullptr);
+		return nullptr;
+	}
+
+	SlowTask.EnterProgressFrame(1, FText::Format(NSLOCTEXT("UnrealPSKPSA", "CreatingAsset", "Creating {0}"), FText::FromName(Name)));
+	FPskMaterialResolver MaterialResolver((TMap<FString, FString>()));
+	const auto SkeletalMesh = CreateMesh(LODs, InParent, Name, Flags, MaterialResolver);
+	FinishReports(LODs, SkeletalMesh);
+	return SkeletalMesh;
+}
+
+bool UPskFactory::ReadMeshLODs(const FString& Filename, TArray<FPskMeshImportData>& OutLODs, FPskImportProgress* Progress)
+{
+	return FPskAsyncImport::ReadLODs(Filename, OutLODs, Progress, &ReadMesh);
+}
+
+void UPskFactory::FinishReports(TArrayView<FPskMeshImportData> LODs, const UObject* Asset)
+{
+	for (auto& LOD : LODs)
+	{
+		LOD.Report.Finish(Asset);
+	}
+}
+
+bool UPskFactory::ReadMesh(const FString& Filename, FPskMeshImportData& OutMeshData, FPskImportProgress* Progress)
+{
+	auto& Report = OutMeshData.Report;
+	Report.Filename = Filename;
+	Report.Memory.Begin();
+	
+	TUniquePtr<FPskReader> Reader;
+	const auto MaxInfluences = FMath::Clamp(CVarPskMaxBoneInfluences.GetValueOnAnyThread(), 1, MAX_TOTAL_INFLUENCES);
+	const auto TangentMethod = FPskMeshConverter::GetTangentMethod();
+	uint64 CacheHash;
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Read, Report.Timings.Read);
+		
+		Reader = MakeUnique<FPskReader>(Filename);
+		if (!Reader->bIsValid) return false;
+
+		Report.Counters.BytesRead = Reader->GetFileSize();
+		Report.Counters.Points = Reader->GetCount(EPskChunk::Points);
+		Report.Counters.Wedges = Reader->GetCount(EPskChunk::Wedges);
+		Report.Counters.Faces = Reader->GetCount(EPskChunk::Faces);
+		Report.Counters.Influences = Reader->GetCount(EPskChunk::Influences);
+		Report.Counters.Bones = Reader->GetCount(EPskChunk::Bones);
+		Report.Counters.Materials = Reader->GetCount(EPskChunk::Materials);
+		Report.Counters.MorphTargets = Reader->GetCount(EPskChunk::MorphInfos);
+
+		OutMeshData.ChunkHashes = UPskAssetImportData::HashChunks(Reader->GetChunks());
+		// converted data depends on the influence cap and the tangent method as well as on the file
+		const auto Settings = (static_cast<uint64>(TangentMethod) << 32) | static_cast<uint32>(MaxInfluences);
+		CacheHash = CityHash128to64(Uint128_64(UPskAssetImportData::GetContentHash(OutMeshData.ChunkHashes), Settings));
+		if (FPskImportDataCache::Get(CacheHash, OutMeshData))
+		{
+			Report.bFromCache = true;
+			Report.Memory.ImportDataBytes = OutMeshData.GetAllocatedSize();
+			return true;
 		}
-		Swap(Face.WedgeIndex[0], Face.WedgeIndex[2]);
-		Swap(Face.TangentZ[0], Face.TangentZ[2]);
 
-		SkeletalMeshImportData.Faces.Add(Face);
+		// decode every chunk the conversion needs up front so reading and converting are timed separately
+		Reader->GetVertices();
+		Reader->GetWedges();
+		Reader->GetFaces();
+		Reader->GetNormals();
+		Reader->GetTangents();
+		Reader->GetVertexColors();
+		Reader->GetExtraUVs();
+		Reader->GetMaterials();
+		Reader->GetMorphInfos();
+		Reader->GetMorphDatas();
+		Reader->GetBones();
+		Reader->GetInfluences();
 	}
 
-	TArray<FString> AddedBoneNames;
-	for (auto PskBone : Data.Bones)
+	if (Progress != nullptr && !Progress->EnterStage(EPskImportStage::Convert)) return false;
+
+	PSK_IMPORT_STAGE(STAT_PskImport_Convert, Report.Timings.Convert);
+	
+	auto& Data = *Reader;
+	const auto Materials = Data.GetMaterials();
+	const auto MorphInfos = Data.GetMorphInfos();
+	const auto MorphDatas = Data.GetMorphDatas();
+	const auto Bones = Data.GetBones();
+	const auto Influences = Data.GetInfluences();
+	
+	auto& SkeletalMeshImportData = OutMeshData.SkeletalMeshImportData;
+
+	// everything that is not geometry is taken from the reader first, so it can be released right after conversion
+	// duplicate bone names collapse onto their first occurrence, parents and influences are remapped to match
+	TMap<FString, int32> BoneIndexByName;
+	TArray<int32> BoneRemap;
+	BoneIndexByName.Reserve(Bones.Num());
+	BoneRemap.SetNumUninitialized(Bones.Num());
+	SkeletalMeshImportData.RefBonesBinary.Reserve(Bones.Num());
+	for (auto PskBoneIndex = 0; PskBoneIndex < Bones.Num(); PskBoneIndex++)
 	{
+		const auto& PskBone = Bones[PskBoneIndex];
+		
 		SkeletalMeshImportData::FBone Bone;
 		Bone.Name = PskBone.Name;
-		if (AddedBoneNames.Contains(Bone.Name)) continue;
+		if (const auto ExistingIndex = BoneIndexByName.Find(Bone.Name))
+		{
+			BoneRemap[PskBoneIndex] = *ExistingIndex;
+			continue;
+		}
 		
 		Bone.NumChildren = PskBone.NumChildren;
-		Bone.ParentIndex = PskBone.ParentIndex == -1 ? INDEX_NONE : PskBone.ParentIndex;
+		Bone.ParentIndex = PskBone.ParentIndex == -1 || !BoneRemap.IsValidIndex(PskBone.ParentIndex) || PskBone.ParentIndex >= PskBoneIndex
+			? INDEX_NONE
+			: BoneRemap[PskBone.ParentIndex];
 		
 		auto PskBonePos = PskBone.BonePos;
 		FTransform3f PskTransform;
@@ -99,66 +350,137 @@ UObject* UPskFactory::Import(const FString& Filename, UObject* Parent, const FNa
 		BonePos.ZSize = PskBonePos.ZSize;
 
 		Bone.BonePos = BonePos;
-		SkeletalMeshImportData.RefBonesBinary.Add(Bone);
-		AddedBoneNames.Add(Bone.Name);
+		BoneRemap[PskBoneIndex] = SkeletalMeshImportData.RefBonesBinary.Add(Bone);
+		BoneIndexByName.Add(Bone.Name, BoneRemap[PskBoneIndex]);
 	}
 
-	for (auto PskInfluence : Data.Influences)
-	{
-		SkeletalMeshImportData::FRawBoneInfluence Influence;
-		Influence.BoneIndex = PskInfluence.BoneIdx;
-		Influence.VertexIndex = PskInfluence.PointIdx;
-		Influence.Weight = PskInfluence.Weight;
-		SkeletalMeshImportData.Influences.Add(Influence);
-	}
+	// handing the builder sorted, capped and normalized influences spares it doing so serially
+	Report.Counters.InfluencesRemoved = FPskMeshConverter::NormalizeInfluences(Influences, BoneRemap, Data.GetVertices().Num(), MaxInfluences,
+																			   SkeletalMeshImportData.Influences);
 
-	for (auto PskMaterial : Data.Materials)
+	for (auto PskMaterial : Materials)
 	{
 		SkeletalMeshImportData::FMaterial Material;
 		Material.MaterialImportName = PskMaterial.MaterialName;
+		SkeletalMeshImportData.Materials.Add(Material);
+	}
+	
+	SkeletalMeshImportData.MaxMaterialIndex = SkeletalMeshImportData.Materials.Num()-1;
+
+	OutMeshData.bHasVertexNormals = Data.HasVertexNormals();
+	OutMeshData.bHasMorphData = Data.HasMorphData();
+	OutMeshData.MorphInfos = TArray<VMorphInfo>(MorphInfos);
+	OutMeshData.MorphDatas = TArray<VMorphData>(MorphDatas);
 
-		UObject* MatParent;
-		auto FoundMaterialPath = MaterialNameToPathMap.Find(*Material.MaterialImportName);
-		if (FoundMaterialPath != nullptr)
+	{
+		FPskMeshBuffers Buffers;
+		if (!FPskMeshConverter::Convert(Data, Buffers, true))
 		{
-			MatParent = CreatePackage(**FoundMaterialPath);
+			UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s has wedges or faces referencing points or wedges it does not contain, skipping it"), *Filename);
+			return false;
 		}
-		else
+		Report.Memory.Sample();
+		Reader.Reset();
+
+		if (TangentMethod == EPskTangentMethod::Fast)
 		{
-			MatParent = Parent;
+			FPskMeshConverter::FindOrGenerateTangents(Buffers, OutMeshData.ChunkHashes, Filename);
 		}
-		
-		auto MaterialAdd = FPskPsaUtils::LocalFindOrCreate<UMaterialInstanceConstant>(UMaterialInstanceConstant::StaticClass(), MatParent, PskMaterial.MaterialName, Flags);
-		Material.Material = MaterialAdd;
-		SkeletalMeshImportData.Materials.Add(Material);
+		OutMeshData.bHasTangents = Buffers.bHasTangents;
+
+		SkeletalMeshImportData.bDiffPose = false;
+		SkeletalMeshImportData.bHasNormals = OutMeshData.bHasVertexNormals;
+		SkeletalMeshImportData.bHasTangents = OutMeshData.bHasTangents;
+		SkeletalMeshImportData.bHasVertexColors = true;
+		SkeletalMeshImportData.NumTexCoords = Buffers.NumUVChannels;
+		SkeletalMeshImportData.bUseT0AsRefPose = false;
+		FPskMeshConverter::ToSkeletalMeshImportData(Buffers, SkeletalMeshImportData);
+		Report.Memory.Sample();
 	}
-	
-	SkeletalMeshImportData.MaxMaterialIndex = SkeletalMeshImportData.Materials.Num()-1;
+	Report.Memory.ImportDataBytes = OutMeshData.GetAllocatedSize();
+
+	// only the import data is alive at this point, storing it streams through one block at a time
+	FPskImportDataCache::Put(CacheHash, OutMeshData);
+	Report.Memory.Sample();
+	return true;
+}
 
-	SkeletalMeshImportData.bDiffPose = false;
-	SkeletalMeshImportData.bHasNormals = Data.bHasVertexNormals;
-	SkeletalMeshImportData.bHasTangents = false;
-	SkeletalMeshImportData.bHasVertexColors = true;
-	SkeletalMeshImportData.NumTexCoords = 1 + Data.ExtraUVs.Num(); 
-	SkeletalMeshImportData.bUseT0AsRefPose = false;
+UObject* UPskFactory::CreateMesh(FPskMeshImportData& MeshData, UObject* Parent, const FName Name, const EObjectFlags Flags, FPskMaterialResolver& MaterialResolver)
+{
+	return CreateMesh(MakeArrayView(&MeshData, 1), Parent, Name, Flags, MaterialResolver);
+}
+
+UObject* UPskFactory::CreateMesh(TArrayView<FPskMeshImportData> LODs, UObject* Parent, const FName Name, const EObjectFlags Flags, FPskMaterialResolver& MaterialResolver, USkeletalMesh* ExistingMesh)
+{
+	check(IsInGameThread());
+	check(LODs.Num() > 0);
+
+	// creating the mesh is accounted to the report of LOD0, lower LOD reports only carry their read stages
+	auto& MeshData = LODs[0];
+	auto& Timings = MeshData.Report.Timings;
+	PSK_IMPORT_STAGE(STAT_PskImport_Create, Timings.Create);
+	
+	auto& SkeletalMeshImportData = MeshData.SkeletalMeshImportData;
+	auto NumLODs = 1;
+	for (; NumLODs < LODs.Num(); NumLODs++)
+	{
+		if (!RemapLODBones(LODs[NumLODs].SkeletalMeshImportData, SkeletalMeshImportData))
+		{
+			UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s is not skinned to the skeleton of LOD0, importing %s with %d LODs"), *LODs[NumLODs].Report.Filename, *Name.ToString(), NumLODs);
+			break;
+		}
+	}
 	
-	const auto Skeleton = FPskPsaUtils::LocalCreate<USkeleton>(USkeleton::StaticClass(), Parent,  Name.ToString().Append("_Skeleton"), Flags);
+	TArray<FString> MaterialNames;
+	TArray<UMaterialInterface*> Materials;
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Materials, Timings.Materials);
 
-	FReferenceSkeleton RefSkeleton;
-	auto SkeletalDepth = 0;
-	ProcessSkeleton(SkeletalMeshImportData, Skeleton, RefSkeleton, SkeletalDepth);
-
-	TArray<FVector3f> LODPoints;
-	TArray<SkeletalMeshImportData::FMeshWedge> LODWedges;
-	TArray<SkeletalMeshImportData::FMeshFace> LODFaces;
-	TArray<SkeletalMeshImportData::FVertInfluence> LODInfluences;
-	TArray<int32> LODPointToRawMap;
-	SkeletalMeshImportData.CopyLODImportData(LODPoints, LODWedges, LODFaces, LODInfluences, LODPointToRawMap);
-
-	FSkeletalMeshLODModel LODModel;
-	LODModel.NumTexCoords = FMath::Max<uint32>(1, SkeletalMeshImportData.NumTexCoords);
+		auto& MeshMaterials = SkeletalMeshImportData.Materials;
+		for (auto LODIndex = 1; LODIndex < NumLODs; LODIndex++)
+		{
+			MergeLODMaterials(LODs[LODIndex].SkeletalMeshImportData, MeshMaterials);
+		}
+		
+		for (const auto& Material : MeshMaterials)
+		{
+			MaterialNames.Add(Material.MaterialImportName);
+		}
+		
+		Materials = MaterialResolver.Resolve(MaterialNames, Parent, Flags);
+		for (auto i = 0; i < Materials.Num(); i++)
+		{
+			MeshMaterials[i].Material = Materials[i];
+		}
+		
+		SkeletalMeshImportData.MaxMaterialIndex = MeshMaterials.Num() - 1;
+		for (auto LODIndex = 1; LODIndex < NumLODs; LODIndex++)
+		{
+			LODs[LODIndex].SkeletalMeshImportData.Materials = MeshMaterials;
+			LODs[LODIndex].SkeletalMeshImportData.MaxMaterialIndex = MeshMaterials.Num() - 1;
+		}
+	}
 	
-	const auto SkeletalMesh = FPskPsaUtils::LocalCreate<USkeletalMesh>(USkeletalMesh::StaticClass(), Parent, Name.ToString(), Flags);
+	const auto SkeletonName = Name.ToString().Append("_Skeleton");
+	auto bCreatedSkeleton = false;
+	// bones are merged into the skeleton an existing mesh already uses, which keeps its sockets, virtual bones and curves
+	auto Skeleton = ExistingMesh != nullptr ? ExistingMesh->GetSkeleton() : nullptr;
+	FReferenceSkeleton RefSkeleton;
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Skeleton, Timings.Skeleton);
+		
+		if (Skeleton == nullptr)
+		{
+			Skeleton = FPskSkeletonCache::FindOrCreate(SkeletalMeshImportData, Parent, SkeletonName, Flags, bCreatedSkeleton);
+		}
+
+		auto SkeletalDepth = 0;
+		ProcessSkeleton(SkeletalMeshImportData, Skeleton, RefSkeleton, SkeletalDepth);
+	}
+
+	const auto SkeletalMesh = ExistingMesh != nullptr
+		? ExistingMesh
+		: FPskPsaUtils::LocalCreate<USkeletalMesh>(USkeletalMesh::StaticClass(), Parent, Name.ToString(), Flags);
 	SkeletalMesh->PreEditChange(nullptr);
 	SkeletalMesh->InvalidateDeriveDataCacheGUID();
 	SkeletalMesh->UnregisterAllMorphTarget();
@@ -167,35 +489,82 @@ UObject* UPskFactory::Import(const FString& Filename, UObject* Parent, const FNa
 	SkeletalMesh->GetMaterials().Empty();
 	SkeletalMesh->SetHasVertexColors(true);
 
+	TArray<FPskChunkHash> ChunkHashes;
+	for (auto LODIndex = 0; LODIndex < NumLODs; LODIndex++)
+	{
+		UPskAssetImportData::AppendLODChunkHashes(ChunkHashes, LODs[LODIndex].ChunkHashes, LODIndex);
+	}
+	UPskAssetImportData::Assign(SkeletalMesh, MeshData.Report.Filename, ChunkHashes)->SetMaterials(MaterialNames, Materials);
+
 	FSkeletalMeshModel* ImportedResource = SkeletalMesh->GetImportedModel();
 	auto& SkeletalMeshLODInfos = SkeletalMesh->GetLODInfoArray();
-	SkeletalMeshLODInfos.Empty();
-	SkeletalMeshLODInfos.Add(FSkeletalMeshLODInfo());
-	SkeletalMeshLODInfos[0].ReductionSettings.NumOfTrianglesPercentage = 1.0f;
-	SkeletalMeshLODInfos[0].ReductionSettings.NumOfVertPercentage = 1.0f;
-	SkeletalMeshLODInfos[0].ReductionSettings.MaxDeviationPercentage = 0.0f;
-	SkeletalMeshLODInfos[0].LODHysteresis = 0.02f;
-
-	ImportedResource->LODModels.Empty();
-	ImportedResource->LODModels.Add(new FSkeletalMeshLODModel);
+	ImportedResource->LODModels.Empty(NumLODs);
+	
+	// LODs the mesh already has keep their screen size, reduction and bone settings, their sections are rebuilt
+	const auto NumKeptLODs = FMath::Min(SkeletalMeshLODInfos.Num(), NumLODs);
+	SkeletalMeshLODInfos.SetNum(NumKeptLODs);
+	for (auto& LODInfo : SkeletalMeshLODInfos)
+	{
+		LODInfo.LODMaterialMap.Empty();
+	}
+	for (auto LODIndex = 0; LODIndex < NumLODs; LODIndex++)
+	{
+		ImportedResource->LODModels.Add(new FSkeletalMeshLODModel);
+		if (LODIndex < NumKeptLODs) continue;
+		
+		auto& LODInfo = SkeletalMeshLODInfos.AddDefaulted_GetRef();
+		LODInfo.ReductionSettings.NumOfTrianglesPercentage = 1.0f;
+		LODInfo.ReductionSettings.NumOfVertPercentage = 1.0f;
+		LODInfo.ReductionSettings.MaxDeviationPercentage = 0.0f;
+		LODInfo.LODHysteresis = 0.02f;
+		// every LOD takes over at half the screen size of the one before it
+		LODInfo.ScreenSize = 1.0f / (1 << LODIndex);
+	}
+	
 	SkeletalMesh->SetRefSkeleton(RefSkeleton);
 	SkeletalMesh->CalculateInvRefMatrices();
 
-	SkeletalMesh->SaveLODImportedData(0, SkeletalMeshImportData);
-	FSkeletalMeshBuildSettings BuildOptions;
-	BuildOptions.bRemoveDegenerates = true;
-	BuildOptions.bRecomputeNormals = !Data.bHasVertexNormals;
-	BuildOptions.bRecomputeTangents = true;
-	BuildOptions.bUseMikkTSpace = true;
-	SkeletalMesh->GetLODInfo(0)->BuildSettings = BuildOptions;
-	SkeletalMesh->SetImportedBounds(FBoxSphereBounds(FBoxSphereBounds3f(FBox3f(SkeletalMeshImportData.Points))));
-
-	auto& MeshBuilderModule = IMeshBuilderModule::GetForRunningPlatform();
-	const FSkeletalMeshBuildParameters SkeletalMeshBuildParameters(SkeletalMesh, GetTargetPlatformManagerRef().GetRunningTargetPlatform(), 0, false);
-	if (!MeshBuilderModule.BuildSkeletalMesh(SkeletalMeshBuildParameters))
 	{
-		SkeletalMesh->MarkAsGarbage();
-		return nullptr;
+		PSK_IMPORT_STAGE(STAT_PskImport_Build, Timings.Build);
+
+		SkeletalMesh->SetImportedBounds(FBoxSphereBounds(FBoxSphereBounds3f(FBox3f(SkeletalMeshImportData.Points))));
+		for (auto LODIndex = 0; LODIndex < NumLODs; LODIndex++)
+		{
+			auto& LODImportData = LODs[LODIndex].SkeletalMeshImportData;
+			SkeletalMesh->SaveLODImportedData(LODIndex, LODImportData);
+			MeshData.Report.Memory.Sample();
+			
+			// the builder loads its own copy of the saved data, only bones and materials are needed past this point
+			LODImportData.Points.Empty();
+			LODImportData.Wedges.Empty();
+			LODImportData.Faces.Empty();
+			LODImportData.Influences.Empty();
+			LODImportData.PointToRawMap.Empty();
+			
+			FSkeletalMeshBuildSettings BuildOptions;
+			BuildOptions.bRemoveDegenerates = true;
+			BuildOptions.bRecomputeNormals = !LODs[LODIndex].bHasVertexNormals;
+			BuildOptions.bRecomputeTangents = !LODs[LODIndex].bHasTangents;
+			BuildOptions.bUseMikkTSpace = true;
+			SkeletalMesh->GetLODInfo(LODIndex)->BuildSettings = BuildOptions;
+		}
+
+		// the builder works on shared mesh state, so LODs are built one after another in a single pass
+		auto& MeshBuilderModule = IMeshBuilderModule::GetForRunningPlatform();
+		for (auto LODIndex = 0; LODIndex < NumLODs; LODIndex++)
+		{
+			const FSkeletalMeshBuildParameters SkeletalMeshBuildParameters(SkeletalMesh, GetTargetPlatformManagerRef().GetRunningTargetPlatform(), LODIndex, false);
+			if (!MeshBuilderModule.BuildSkeletalMesh(SkeletalMeshBuildParameters))
+			{
+				// a mesh being reimported is still referenced, it is left for the user to reimport again
+				if (ExistingMesh == nullptr)
+				{
+					SkeletalMesh->MarkAsGarbage();
+				}
+				return nullptr;
+			}
+			MeshData.Report.Memory.Sample();
+		}
 	}
 
 	for (auto Material : SkeletalMeshImportData.Materials)
@@ -203,46 +572,42 @@ UObject* UPskFactory::Import(const FString& Filename, UObject* Parent, const FNa
 		SkeletalMesh->GetMaterials().Add(FSkeletalMaterial(Material.Material.Get()));
 	}
 
-	// currently not working
-	if (Data.bHasMorphData)
+	if (LODs.ContainsByPredicate([](const FPskMeshImportData& LOD) { return LOD.bHasMorphData; }))
 	{
-		auto DataPosition = 0;
+		PSK_IMPORT_STAGE(STAT_PskImport_MorphTargets, Timings.MorphTargets);
 		
-		for (auto [Name, VertexCount] : Data.MorphInfos)
+		for (auto LODIndex = 0; LODIndex < NumLODs; LODIndex++)
 		{
-			auto MorphTarget = NewObject<UMorphTarget>(SkeletalMesh, Name);
+			if (!LODs[LODIndex].bHasMorphData) continue;
 			
-			TArray<FMorphTargetDelta> Deltas;
-			for (auto i = DataPosition; i < DataPosition + VertexCount; i++)
-			{
-				auto [PositionDelta, TangentZDelta, PointIdx] = Data.MorphDatas[i];
-				
-				FMorphTargetDelta Delta;
-				Delta.PositionDelta = PositionDelta;
-				Delta.TangentZDelta = TangentZDelta;
-				Delta.SourceIdx = PointIdx;
-				Deltas.Add(Delta);
-			}
-			MorphTarget->PopulateDeltas(Deltas, 0, LODModel.Sections);
-			MorphTarget->BaseSkelMesh = SkeletalMesh;
-			SkeletalMesh->GetMorphTargets().Add(MorphTarget);
-			DataPosition += VertexCount;
+			CreateMorphTargets(LODs[LODIndex].MorphInfos, LODs[LODIndex].MorphDatas, SkeletalMesh, LODIndex);
 		}
-		
 		SkeletalMesh->InitMorphTargetsAndRebuildRenderData();
 	}
 	
-	SkeletalMesh->PostEditChange();
-	
-	SkeletalMesh->SetSkeleton(Skeleton);
-	Skeleton->MergeAllBonesToBoneTree(SkeletalMesh);
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Skeleton, Timings.Skeleton);
+		
+		if (!Skeleton->MergeAllBonesToBoneTree(SkeletalMesh) && !bCreatedSkeleton)
+		{
+			// the skeleton that failed may well be the one named SkeletonName, which must not be replaced
+			const auto NewSkeletonName = FPskPsaUtils::MakeUniqueAssetName(Parent, SkeletonName);
+			UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s could not be merged into %s, creating skeleton %s"), *Name.ToString(), *Skeleton->GetName(), *NewSkeletonName);
+			Skeleton = FPskPsaUtils::LocalCreate<USkeleton>(USkeleton::StaticClass(), Parent, NewSkeletonName, Flags);
+			Skeleton->MergeAllBonesToBoneTree(SkeletalMesh);
+			bCreatedSkeleton = true;
+		}
+		SkeletalMesh->SetSkeleton(Skeleton);
+		FPskSkeletonCache::Add(SkeletalMeshImportData, Skeleton);
+	}
 	
-	FAssetRegistryModule::AssetCreated(SkeletalMesh);
-	SkeletalMesh->MarkPackageDirty();
-
-	Skeleton->PostEditChange();
-	FAssetRegistryModule::AssetCreated(Skeleton);
-	Skeleton->MarkPackageDirty();
+	// meshes sharing a skeleton only finalize it once per batch
+	FPskImportTransaction::AssetChanged(SkeletalMesh, ExistingMesh == nullptr);
+	FPskImportTransaction::AssetChanged(Skeleton, bCreatedSkeleton);
+	if (ExistingMesh != nullptr)
+	{
+		FPskImportTransaction::ReregisterComponents();
+	}
 
 	return SkeletalMesh;
 }
@@ -0,0 +1,203 @@
+﻿#include "PskImportCommandlet.h"
+
+#include "PskBatchImporter.h"
+#include "PskPsaUtils.h"
+#include "UnrealPSKPSA.h"
+#include "Dom/JsonObject.h"
+#include "FileHelpers.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+
+UPskImportCommandlet::UPskImportCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UPskImportCommandlet::Main(const FString& Params)
+{
+	FString Source;
+	FString Destination = "/Game";
+	FString MaterialMapFilename;
+	FString ReportFilename = FPskImportReport::GetDefaultReportFilename();
+	FParse::Value(*Params, TEXT("Source="), Source);
+	FParse::Value(*Params, TEXT("Destination="), Destination);
+	FParse::Value(*Params, TEXT("MaterialMap="), MaterialMapFilename);
+	FParse::Value(*Params, TEXT("Report="), ReportFilename);
+	const auto bRecursive = FParse::Param(*Params, TEXT("Recursive"));
+	const auto bSave = !FParse::Param(*Params, TEXT("NoSave"));
+
+	if (Source.IsEmpty() || !FPackageName::IsValidLongPackageName(Destination))
+	{
+		UE_LOG(LogUnrealPSKPSA, Error, TEXT("Usage: -run=PskImport -Source=<Directory|Manifest> -Destination=/Game/Path [-MaterialMap=<Json>] [-Report=<Json>] [-Recursive] [-NoSave]"));
+		return 2;
+	}
+
+	TArray<FString> Files;
+	if (!GatherFiles(Source, bRecursive, Files))
+	{
+		UE_LOG(LogUnrealPSKPSA, Error, TEXT("Could not read source %s"), *Source);
+		return 2;
+	}
+
+	// Name_LODn siblings are imported as LODs of their Name_LOD0 file, not as meshes of their own
+	TSet<FString> LODFiles;
+	for (const auto& File : Files)
+	{
+		const auto LODFilenames = FPskPsaUtils::FindLODFilenames(File);
+		for (auto LODIndex = 1; LODIndex < LODFilenames.Num(); LODIndex++)
+		{
+			LODFiles.Add(FPaths::ConvertRelativePathToFull(LODFilenames[LODIndex]));
+		}
+	}
+	Files.RemoveAll([&LODFiles](const FString& File) { return LODFiles.Contains(FPaths::ConvertRelativePathToFull(File)); });
+
+	TMap<FString, FString> MaterialNameToPathMap;
+	if (!MaterialMapFilename.IsEmpty() && !LoadMaterialMap(MaterialMapFilename, MaterialNameToPathMap))
+	{
+		UE_LOG(LogUnrealPSKPSA, Error, TEXT("Could not read material map %s"), *MaterialMapFilename);
+		return 2;
+	}
+
+	// assets are created next to their parent, so the parent is the destination folder itself
+	const auto DestinationPackage = CreatePackage(*Destination);
+	
+	TArray<FPskBatchImportTask> Tasks;
+	for (const auto& File : Files)
+	{
+		auto& Task = Tasks.AddDefaulted_GetRef();
+		Task.Filename = File;
+		Task.Parent = DestinationPackage;
+		Task.Name = FName(FPaths::GetBaseFilename(File).Replace(TEXT("_LOD0"), TEXT("")));
+	}
+
+	const auto StartTime = FPlatformTime::Seconds();
+	FPskBatchImportStats Stats;
+	auto Results = FPskBatchImporter::Import(Tasks, MaterialNameToPathMap, RF_Public | RF_Standalone, &Stats);
+
+	auto NumFailed = 0;
+	TArray<FPskImportReport> Reports;
+	for (auto& Result : Results)
+	{
+		auto& Report = Result.Report;
+		if (Report.bSucceeded && bSave)
+		{
+			PSK_IMPORT_STAGE(STAT_PskImport_Save, Report.Timings.Save);
+			Report.bSucceeded = SavePackage(Result.Asset->GetPackage(), Result.Asset);
+		}
+		NumFailed += !Report.bSucceeded;
+
+		UE_LOG(LogUnrealPSKPSA, Display, TEXT("PskImport: %s"), *FPskImportReport::ToJsonString(Report.ToJson()));
+		Reports.Add(Report);
+	}
+
+	// skeletons and materials created along the way live in their own packages
+	auto SharedSaveSeconds = 0.0;
+	if (bSave)
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Save, SharedSaveSeconds);
+		
+		TArray<UPackage*> DirtyPackages;
+		FEditorFileUtils::GetDirtyContentPackages(DirtyPackages);
+		for (const auto Package : DirtyPackages)
+		{
+			if (!SavePackage(Package, nullptr))
+			{
+				NumFailed++;
+			}
+		}
+	}
+
+	UE_LOG(LogUnrealPSKPSA, Display, TEXT("PskImport: {\"files\":%d,\"failed\":%d,\"bytes\":%lld,\"import\":%.6f,\"static_mesh_build\":%.6f,\"shared_save\":%.6f}"),
+		Stats.NumFiles, NumFailed, Stats.TotalBytes, Stats.TotalSeconds, Stats.StaticMeshBuildSeconds, SharedSaveSeconds);
+	FPskImportReport::WriteBatchReport(Reports, FPlatformTime::Seconds() - StartTime, ReportFilename);
+	
+	return NumFailed > 0 ? 1 : 0;
+}
+
+bool UPskImportCommandlet::GatherFiles(const FString& Source, const bool bRecursive, TArray<FString>& OutFiles)
+{
+	if (IFileManager::Get().DirectoryExists(*Source))
+	{
+		for (const auto Extension : { TEXT("*.psk"), TEXT("*.pskx") })
+		{
+			TArray<FString> Found;
+			if (bRecursive)
+			{
+				IFileManager::Get().FindFilesRecursive(Found, *Source, Extension, true, false);
+			}
+			else
+			{
+				IFileManager::Get().FindFiles(Found, *FPaths::Combine(Source, Extension), true, false);
+				for (auto& File : Found)
+				{
+					File = FPaths::Combine(Source, File);
+				}
+			}
+			OutFiles.Append(Found);
+		}
+		
+		OutFiles.Sort();
+		return true;
+	}
+
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Source)) return false;
+
+	const auto ManifestDirectory = FPaths::GetPath(Source);
+	for (auto& Line : Lines)
+	{
+		Line.TrimStartAndEndInline();
+		if (Line.IsEmpty() || Line.StartsWith("#")) continue;
+		
+		OutFiles.Add(FPaths::IsRelative(Line) ? FPaths::Combine(ManifestDirectory, Line) : Line);
+	}
+	
+	return true;
+}
+
+bool UPskImportCommandlet::LoadMaterialMap(const FString& Filename, TMap<FString, FString>& OutMaterialNameToPathMap)
+{
+	FString Json;
+	if (!FFileHelper::LoadFileToString(Json, *Filename)) return false;
+
+	TSharedPtr<FJsonObject> Object;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Object) || !Object.IsValid()) return false;
+
+	for (const auto& Pair : Object->Values)
+	{
+		FString Path;
+		if (Pair.Value->TryGetString(Path))
+		{
+			OutMaterialNameToPathMap.Add(Pair.Key, Path);
+		}
+	}
+	
+	return true;
+}
+
+bool UPskImportCommandlet::SavePackage(UPackage* Package, UObject* Asset)
+{
+	if (Package == nullptr || !Package->IsDirty()) return true;
+	
+	const auto Filename = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension());
+
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	SaveArgs.SaveFlags = SAVE_NoError;
+	
+	if (!UPackage::SavePackage(Package, Asset, *Filename, SaveArgs))
+	{
+		UE_LOG(LogUnrealPSKPSA, Error, TEXT("Failed to save %s"), *Package->GetName());
+		return false;
+	}
+	
+	return true;
+}
@@ -0,0 +1,87 @@
+﻿#pragma once
+#include "ActorXModels.h"
+#include "PskAssetImportData.h"
+#include "PskImportStats.h"
+#include "MeshDescription.h"
+#include "StaticMeshAttributes.h"
+#include "Rendering/SkeletalMeshLODImporterData.h"
+#include <atomic>
+
+enum class EPskImportStage : uint8
+{
+	Read,
+	Convert
+};
+
+/*
+ * Shared between a read stage running in the background and the game thread waiting on it. The worker publishes the
+ * stage it is in, the game thread can ask it to stop, which the worker honours before starting its next stage.
+ */
+struct FPskImportProgress
+{
+	std::atomic<EPskImportStage> Stage { EPskImportStage::Read };
+	std::atomic<bool> bCancelRequested { false };
+
+	// false if the import was canceled and the next stage should not run
+	bool EnterStage(const EPskImportStage NextStage)
+	{
+		if (bCancelRequested) return false;
+		
+		Stage = NextStage;
+		return true;
+	}
+};
+
+/*
+ * Converted file contents the factories hand from their read stage to their create stage. Filling these touches no
+ * UObjects, so the read stage can run on any thread; materials are only named here and resolved on the game thread.
+ */
+struct FPskMeshImportData
+{
+	FSkeletalMeshImportData SkeletalMeshImportData;
+	TArray<VMorphInfo> MorphInfos;
+	TArray<VMorphData> MorphDatas;
+	
+	bool bHasVertexNormals = false;
+	// tangents came with the file or were generated, the builder keeps them instead of running MikkTSpace
+	bool bHasTangents = false;
+	bool bHasMorphData = false;
+
+	// not cached, always hashed from the file being imported
+	TArray<FPskChunkHash> ChunkHashes;
+	FPskImportReport Report;
+
+	int64 GetAllocatedSize() const
+	{
+		const auto& Data = SkeletalMeshImportData;
+		return Data.Points.GetAllocatedSize() + Data.Wedges.GetAllocatedSize() + Data.Faces.GetAllocatedSize()
+			+ Data.Influences.GetAllocatedSize() + Data.PointToRawMap.GetAllocatedSize() + Data.RefBonesBinary.GetAllocatedSize()
+			+ MorphInfos.GetAllocatedSize() + MorphDatas.GetAllocatedSize();
+	}
+};
+
+struct FPskxMeshImportData
+{
+	FMeshDescription MeshDescription;
+	TArray<FString> MaterialNames;
+	
+	bool bHasVertexNormals = false;
+	bool bHasTangents = false;
+
+	TArray<FPskChunkHash> ChunkHashes;
+	FPskImportReport Report;
+
+	// estimated from element counts, the attribute arrays make up nearly all of a description
+	int64 GetAllocatedSize() const
+	{
+		const FStaticMeshConstAttributes Attributes(MeshDescription);
+		const int64 NumUVChannels = Attributes.GetVertexInstanceUVs().GetNumChannels();
+		const int64 VertexInstanceSize = sizeof(FVertexID) + 2 * sizeof(FVector3f) + sizeof(float) + sizeof(FVector4f) + NumUVChannels * sizeof(FVector2f);
+		
+		return MeshDescription.Vertices().Num() * static_cast<int64>(sizeof(FVector3f))
+			+ MeshDescription.VertexInstances().Num() * VertexInstanceSize
+			+ MeshDescription.Edges().Num() * static_cast<int64>(2 * sizeof(FVertexID))
+			+ MeshDescription.Triangles().Num() * static_cast<int64>(3 * sizeof(FVertexInstanceID) + sizeof(FPolygonGroupID))
+			+ MaterialNames.GetAllocatedSize();
+	}
+};
@@ -0,0 +1,319 @@
+﻿#include "PskImportDataCache.h"
+
+#include "DerivedDataCache.h"
+#include "DerivedDataCacheInterface.h"
+#include "DerivedDataRequestOwner.h"
+#include "DerivedDataValue.h"
+#include "PskImportData.h"
+#include "UnrealPSKPSA.h"
+#include "IO/IoHash.h"
+#include "Serialization/CustomVersion.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/LargeMemoryReader.h"
+#include "Serialization/LargeMemoryWriter.h"
+
+// change whenever the conversion or the layout below changes, every cached entry is invalidated with it
+#define PSK_IMPORT_DATA_CACHE_VERSION TEXT("4F7A19C2E05B4D8E9A63B1D27C8E5F10")
+
+// converted data is streamed through blocks of an eighth of its size, within these bounds, instead of a full copy
+constexpr int64 MinBlockSize = 64 * 1024;
+constexpr int64 MaxBlockSize = 32 * 1024 * 1024;
+
+template <typename T>
+static void SerializeBlittable(FArchive& Ar, TArray<T>& Array)
+{
+	auto Num = Array.Num();
+	Ar << Num;
+	if (Ar.IsLoading())
+	{
+		// a corrupt count must not make us allocate more than the entry could possibly hold
+		if (Num < 0 || Num > (Ar.TotalSize() - Ar.Tell()) / static_cast<int64>(sizeof(T)))
+		{
+			Ar.SetError();
+			return;
+		}
+		Array.SetNumUninitialized(Num);
+	}
+	Ar.Serialize(Array.GetData(), static_cast<int64>(Array.Num()) * sizeof(T));
+}
+
+static void Serialize(FArchive& Ar, FPskMeshImportData& MeshData)
+{
+	Ar << MeshData.SkeletalMeshImportData;
+	SerializeBlittable(Ar, MeshData.MorphInfos);
+	SerializeBlittable(Ar, MeshData.MorphDatas);
+	Ar << MeshData.bHasVertexNormals;
+	Ar << MeshData.bHasTangents;
+	Ar << MeshData.bHasMorphData;
+}
+
+static void Serialize(FArchive& Ar, FPskxMeshImportData& MeshData)
+{
+	Ar << MeshData.MeshDescription;
+	Ar << MeshData.MaterialNames;
+	Ar << MeshData.bHasVertexNormals;
+	Ar << MeshData.bHasTangents;
+}
+
+static FString MakeKey(const TCHAR* Kind, const uint64 ContentHash)
+{
+	return FDerivedDataCacheInterface::BuildCacheKey(TEXT("PSKIMPORT"), PSK_IMPORT_DATA_CACHE_VERSION, *FString::Printf(TEXT("%s_%016llX"), Kind, ContentHash));
+}
+
+static UE::DerivedData::FCacheKey MakeCacheKey(const FString& Key)
+{
+	static const UE::DerivedData::FCacheBucket Bucket(TEXTVIEW("PskImportData"));
+	return { Bucket, FIoHash::HashBuffer(*Key, Key.Len() * sizeof(TCHAR)) };
+}
+
+// blocking, so a stored block can be freed or reused as soon as this returns
+static void PutValue(const FString& Key, const FString& Context, const FSharedBuffer& Data)
+{
+	using namespace UE::DerivedData;
+	
+	FRequestOwner Owner(EPriority::Blocking);
+	GetCache().PutValue({ { FSharedString(Context), MakeCacheKey(Key), FValue::Compress(Data) } }, Owner);
+	Owner.Wait();
+}
+
+static bool GetValue(const FString& Key, const FString& Context, FSharedBuffer& OutData)
+{
+	using namespace UE::DerivedData;
+	
+	auto bFound = false;
+	FRequestOwner Owner(EPriority::Blocking);
+	GetCache().GetValue({ { FSharedString(Context), MakeCacheKey(Key) } }, Owner, [&bFound, &OutData](FCacheGetValueResponse&& Response)
+	{
+		if (Response.Status != EStatus::Ok) return;
+		
+		OutData = Response.Value.GetData().Decompress();
+		bFound = OutData.GetSize() > 0;
+	});
+	Owner.Wait();
+	return bFound;
+}
+
+static FString MakeBlockKey(const FString& Key, const int32 BlockIndex)
+{
+	return FString::Printf(TEXT("%s_BLOCK%d"), *Key, BlockIndex);
+}
+
+/*
+ * Serializes straight into cache values of at most one block each, a block is stored and reused as soon as it is
+ * full. Only one block of the serialized data exists at a time next to the import data, so storing an entry stays far
+ * below the 1.5x peak budget instead of doubling the import data with a full serialized copy.
+ */
+class FPskCacheBlockWriter final : public FArchive
+{
+public:
+	FPskCacheBlockWriter(const FString& InKey, const FString& InContext, const int64 InBlockSize)
+		: Key(InKey), Context(InContext), BlockSize(InBlockSize)
+	{
+		SetIsSaving(true);
+		SetIsPersistent(true);
+	}
+
+	virtual void Serialize(void* Data, int64 Num) override
+	{
+		auto Bytes = static_cast<const uint8*>(Data);
+		while (Num > 0)
+		{
+			const auto Count = FMath::Min(Num, BlockSize - Block.Num());
+			Block.Append(Bytes, Count);
+			Bytes += Count;
+			Num -= Count;
+			Offset += Count;
+			
+			if (Block.Num() == BlockSize)
+			{
+				PutBlock();
+			}
+		}
+	}
+
+	virtual int64 Tell() override { return Offset; }
+	virtual int64 TotalSize() override { return Offset; }
+	virtual FString GetArchiveName() const override { return TEXT("FPskCacheBlockWriter"); }
+
+	// stores the last block, then the header that makes the entry visible to readers
+	void Finish()
+	{
+		PutBlock();
+		
+		TArray<uint8> Header;
+		FMemoryWriter HeaderWriter(Header);
+		HeaderWriter << NumBlocks;
+		HeaderWriter << Offset;
+		auto CustomVersions = GetCustomVersions();
+		CustomVersions.Serialize(HeaderWriter);
+		PutValue(Key, Context, MakeSharedBufferFromArray(MoveTemp(Header)));
+	}
+
+private:
+	void PutBlock()
+	{
+		if (Block.IsEmpty()) return;
+		
+		PutValue(MakeBlockKey(Key, NumBlocks++), Context, FSharedBuffer::MakeView(Block.GetData(), Block.Num()));
+		Block.Reset();
+	}
+	
+	FString Key;
+	FString Context;
+	int64 BlockSize;
+	TArray64<uint8> Block;
+	int32 NumBlocks = 0;
+	int64 Offset = 0;
+};
+
+// fetches the blocks of an entry one at a time as the payload is deserialized
+class FPskCacheBlockReader final : public FArchive
+{
+public:
+	FPskCacheBlockReader(const FString& InKey, const FString& InContext, const int32 InNumBlocks, const int64 InTotalSize, const FCustomVersionContainer& CustomVersions)
+		: Key(InKey), Context(InContext), NumBlocks(InNumBlocks), Size(InTotalSize)
+	{
+		SetIsLoading(true);
+		SetIsPersistent(true);
+		SetCustomVersions(CustomVersions);
+	}
+
+	virtual void Serialize(void* Data, int64 Num) override
+	{
+		auto Bytes = static_cast<uint8*>(Data);
+		while (Num > 0)
+		{
+			if (BlockOffset == static_cast<int64>(Block.GetSize()))
+			{
+				Block.Reset();
+				BlockOffset = 0;
+				if (IsError() || NextBlock >= NumBlocks || !GetValue(MakeBlockKey(Key, NextBlock++), Context, Block))
+				{
+					SetError();
+					FMemory::Memzero(Bytes, Num);
+					return;
+				}
+			}
+			
+			const auto Count = FMath::Min(Num, static_cast<int64>(Block.GetSize()) - BlockOffset);
+			FMemory::Memcpy(Bytes, static_cast<const uint8*>(Block.GetData()) + BlockOffset, Count);
+			Bytes += Count;
+			Num -= Count;
+			BlockOffset += Count;
+			Offset += Count;
+		}
+	}
+
+	virtual int64 Tell() override { return Offset; }
+	virtual int64 TotalSize() override { return Size; }
+	virtual FString GetArchiveName() const override { return TEXT("FPskCacheBlockReader"); }
+
+private:
+	FString Key;
+	FString Context;
+	int32 NumBlocks;
+	int64 Size;
+	FSharedBuffer Block;
+	int64 BlockOffset = 0;
+	int32 NextBlock = 0;
+	int64 Offset = 0;
+};
+
+/*
+ * An entry is a header value holding the block count, the payload size and the custom versions the payload was
+ * written with, and the payload itself split over block values. The header is written last, so an entry is only
+ * found once all of its blocks are stored.
+ */
+template <typename MeshDataType>
+static bool GetCached(const TCHAR* Kind, const uint64 ContentHash, MeshDataType& OutMeshData)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskImportDataCache::Get);
+	
+	const auto Key = MakeKey(Kind, ContentHash);
+	const auto& Context = OutMeshData.Report.Filename;
+	FSharedBuffer Header;
+	if (!GetValue(Key, Context, Header)) return false;
+
+	const auto HeaderData = MakeArrayView(static_cast<const uint8*>(Header.GetData()), static_cast<int32>(Header.GetSize()));
+	FMemoryReaderView HeaderReader(HeaderData, true);
+	auto NumBlocks = 0;
+	auto PayloadSize = static_cast<int64>(0);
+	FCustomVersionContainer CustomVersions;
+	HeaderReader << NumBlocks;
+	HeaderReader << PayloadSize;
+	CustomVersions.Serialize(HeaderReader);
+	
+	auto bIsValid = !HeaderReader.IsError() && HeaderReader.AtEnd() && NumBlocks >= 0 && PayloadSize >= 0;
+	if (bIsValid)
+	{
+		FPskCacheBlockReader Reader(Key, Context, NumBlocks, PayloadSize, CustomVersions);
+		Serialize(Reader, OutMeshData);
+		bIsValid = !Reader.IsError() && Reader.Tell() == PayloadSize;
+	}
+	
+	if (!bIsValid)
+	{
+		UE_LOG(LogUnrealPSKPSA, Warning, TEXT("Discarding malformed or incomplete cached import data for %s"), *OutMeshData.Report.Filename);
+		// start over from the file, keeping what the read stage already filled in
+		auto Report = MoveTemp(OutMeshData.Report);
+		auto ChunkHashes = MoveTemp(OutMeshData.ChunkHashes);
+		OutMeshData = MeshDataType();
+		OutMeshData.Report = MoveTemp(Report);
+		OutMeshData.ChunkHashes = MoveTemp(ChunkHashes);
+		return false;
+	}
+	return true;
+}
+
+template <typename MeshDataType>
+static void PutCached(const TCHAR* Kind, const uint64 ContentHash, MeshDataType& MeshData)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskImportDataCache::Put);
+	
+	const auto BlockSize = FMath::Clamp(MeshData.GetAllocatedSize() / 8, MinBlockSize, MaxBlockSize);
+	FPskCacheBlockWriter Writer(MakeKey(Kind, ContentHash), MeshData.Report.Filename, BlockSize);
+	Serialize(Writer, MeshData);
+	Writer.Finish();
+}
+
+bool FPskImportDataCache::Get(const uint64 ContentHash, FPskMeshImportData& OutMeshData)
+{
+	return GetCached(TEXT("psk"), ContentHash, OutMeshData);
+}
+
+bool FPskImportDataCache::Get(const uint64 ContentHash, FPskxMeshImportData& OutMeshData)
+{
+	return GetCached(TEXT("pskx"), ContentHash, OutMeshData);
+}
+
+void FPskImportDataCache::Put(const uint64 ContentHash, FPskMeshImportData& MeshData)
+{
+	PutCached(TEXT("psk"), ContentHash, MeshData);
+}
+
+void FPskImportDataCache::Put(const uint64 ContentHash, FPskxMeshImportData& MeshData)
+{
+	PutCached(TEXT("pskx"), ContentHash, MeshData);
+}
+
+bool FPskImportDataCache::GetTangents(const uint64 InputHash, const FString& Filename, TArray<FVector4f>& OutTangents)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskImportDataCache::GetTangents);
+	
+	TArray64<uint8> Data;
+	if (!GetDerivedDataCacheRef().GetSynchronous(*MakeKey(TEXT("tangents"), InputHash), Data, Filename)) return false;
+
+	FLargeMemoryReader Reader(Data.GetData(), Data.Num(), ELargeMemoryReaderFlags::Persistent);
+	SerializeBlittable(Reader, OutTangents);
+	return !Reader.IsError() && Reader.AtEnd();
+}
+
+void FPskImportDataCache::PutTangents(const uint64 InputHash, const FString& Filename, TArray<FVector4f>& Tangents)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskImportDataCache::PutTangents);
+	
+	FLargeMemoryWriter Writer(0, true);
+	SerializeBlittable(Writer, Tangents);
+	GetDerivedDataCacheRef().Put(*MakeKey(TEXT("tangents"), InputHash), Writer.GetView(), Filename);
+}
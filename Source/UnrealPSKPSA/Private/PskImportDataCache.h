@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+struct FPskMeshImportData;
+struct FPskxMeshImportData;
+
+/*
+ * Keeps converted import data in the derived data cache, keyed by the content hash of the source file. A shared cache
+ * lets every machine after the first skip decoding and converting a file, only the chunk hashing read remains.
+ * Mesh data is streamed to and from the cache in blocks, so neither direction holds a full serialized copy.
+ * Thread safe, the read stages use it from worker threads.
+ */
+class FPskImportDataCache
+{
+public:
+	static bool Get(const uint64 ContentHash, FPskMeshImportData& OutMeshData);
+	static bool Get(const uint64 ContentHash, FPskxMeshImportData& OutMeshData);
+	
+	static void Put(const uint64 ContentHash, FPskMeshImportData& MeshData);
+	static void Put(const uint64 ContentHash, FPskxMeshImportData& MeshData);
+
+	// generated tangents, keyed by a hash of only the chunks they are computed from
+	static bool GetTangents(const uint64 InputHash, const FString& Filename, TArray<FVector4f>& OutTangents);
+	static void PutTangents(const uint64 InputHash, const FString& Filename, TArray<FVector4f>& Tangents);
+};
@@ -0,0 +1,222 @@
+﻿#include "PskImportStats.h"
+
+#include "UnrealPSKPSA.h"
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+DEFINE_STAT(STAT_PskImport_Read);
+DEFINE_STAT(STAT_PskImport_Convert);
+DEFINE_STAT(STAT_PskImport_Create);
+DEFINE_STAT(STAT_PskImport_Materials);
+DEFINE_STAT(STAT_PskImport_Skeleton);
+DEFINE_STAT(STAT_PskImport_Build);
+DEFINE_STAT(STAT_PskImport_MorphTargets);
+DEFINE_STAT(STAT_PskImport_Animation);
+DEFINE_STAT(STAT_PskImport_Save);
+
+DEFINE_STAT(STAT_PskImport_BytesRead);
+DEFINE_STAT(STAT_PskImport_Files);
+DEFINE_STAT(STAT_PskImport_Wedges);
+DEFINE_STAT(STAT_PskImport_Faces);
+DEFINE_STAT(STAT_PskImport_Influences);
+DEFINE_STAT(STAT_PskImport_Bones);
+
+void FPskImportTimings::Accumulate(const FPskImportTimings& Other)
+{
+	Read += Other.Read;
+	Convert += Other.Convert;
+	Create += Other.Create;
+	Materials += Other.Materials;
+	Skeleton += Other.Skeleton;
+	Build += Other.Build;
+	MorphTargets += Other.MorphTargets;
+	Save += Other.Save;
+}
+
+void FPskImportCounters::Accumulate(const FPskImportCounters& Other)
+{
+	BytesRead += Other.BytesRead;
+	Points += Other.Points;
+	Wedges += Other.Wedges;
+	Faces += Other.Faces;
+	Influences += Other.Influences;
+	Bones += Other.Bones;
+	Materials += Other.Materials;
+	MorphTargets += Other.MorphTargets;
+	AnimKeys += Other.AnimKeys;
+	AnimKeysRemoved += Other.AnimKeysRemoved;
+	InfluencesRemoved += Other.InfluencesRemoved;
+}
+
+void FPskImportCounters::UpdateStats() const
+{
+	INC_MEMORY_STAT_BY(STAT_PskImport_BytesRead, BytesRead);
+	INC_DWORD_STAT(STAT_PskImport_Files);
+	INC_DWORD_STAT_BY(STAT_PskImport_Wedges, Wedges);
+	INC_DWORD_STAT_BY(STAT_PskImport_Faces, Faces);
+	INC_DWORD_STAT_BY(STAT_PskImport_Influences, Influences);
+	INC_DWORD_STAT_BY(STAT_PskImport_Bones, Bones);
+}
+
+void FPskImportMemory::Begin()
+{
+	const auto Stats = FPlatformMemory::GetStats();
+	BaselineBytes = Stats.UsedPhysical;
+	BaselinePeakBytes = Stats.PeakUsedPhysical;
+	PeakBytes = 0;
+}
+
+void FPskImportMemory::Sample()
+{
+	if (BaselineBytes == 0) return;
+	
+	const auto Stats = FPlatformMemory::GetStats();
+	PeakBytes = FMath::Max(PeakBytes, static_cast<int64>(Stats.UsedPhysical) - BaselineBytes);
+	if (Stats.PeakUsedPhysical > BaselinePeakBytes)
+	{
+		PeakBytes = FMath::Max(PeakBytes, static_cast<int64>(Stats.PeakUsedPhysical) - BaselineBytes);
+	}
+}
+
+static TSharedRef<FJsonObject> TimingsToJson(const FPskImportTimings& Timings)
+{
+	auto Json = MakeShared<FJsonObject>();
+	Json->SetNumberField("read", Timings.Read);
+	Json->SetNumberField("convert", Timings.Convert);
+	Json->SetNumberField("create", Timings.Create);
+	Json->SetNumberField("materials", Timings.Materials);
+	Json->SetNumberField("skeleton", Timings.Skeleton);
+	Json->SetNumberField("build", Timings.Build);
+	Json->SetNumberField("morph_targets", Timings.MorphTargets);
+	Json->SetNumberField("save", Timings.Save);
+	Json->SetNumberField("total", Timings.GetTotal());
+	return Json;
+}
+
+static TSharedRef<FJsonObject> CountersToJson(const FPskImportCounters& Counters)
+{
+	auto Json = MakeShared<FJsonObject>();
+	Json->SetNumberField("bytes_read", Counters.BytesRead);
+	Json->SetNumberField("points", Counters.Points);
+	Json->SetNumberField("wedges", Counters.Wedges);
+	Json->SetNumberField("faces", Counters.Faces);
+	Json->SetNumberField("influences", Counters.Influences);
+	Json->SetNumberField("influences_removed", Counters.InfluencesRemoved);
+	Json->SetNumberField("bones", Counters.Bones);
+	Json->SetNumberField("materials", Counters.Materials);
+	Json->SetNumberField("morph_targets", Counters.MorphTargets);
+	Json->SetNumberField("anim_keys", Counters.AnimKeys);
+	Json->SetNumberField("anim_keys_removed", Counters.AnimKeysRemoved);
+	return Json;
+}
+
+static TSharedRef<FJsonObject> MemoryToJson(const FPskImportMemory& Memory)
+{
+	auto Json = MakeShared<FJsonObject>();
+	Json->SetNumberField("peak_bytes", Memory.PeakBytes);
+	Json->SetNumberField("import_data_bytes", Memory.ImportDataBytes);
+	Json->SetNumberField("peak_ratio", Memory.GetPeakRatio());
+	return Json;
+}
+
+void FPskImportReport::Finish(const UObject* Asset)
+{
+	Memory.Sample();
+	bSucceeded = Asset != nullptr;
+	AssetPath = Asset != nullptr ? Asset->GetPathName() : FString();
+	Counters.UpdateStats();
+	
+	UE_LOG(LogUnrealPSKPSA, Log, TEXT("PskImportReport: %s"), *ToJsonString(ToJson()));
+}
+
+TSharedRef<FJsonObject> FPskImportReport::ToJson() const
+{
+	auto Json = MakeShared<FJsonObject>();
+	Json->SetStringField("file", Filename);
+	Json->SetStringField("asset", AssetPath);
+	Json->SetBoolField("succeeded", bSucceeded);
+	Json->SetBoolField("from_cache", bFromCache);
+	Json->SetObjectField("seconds", TimingsToJson(Timings));
+	Json->SetObjectField("counters", CountersToJson(Counters));
+	Json->SetObjectField("memory", MemoryToJson(Memory));
+	return Json;
+}
+
+TSharedRef<FJsonObject> FPskImportReport::MakeBatchJson(const TArray<FPskImportReport>& Reports, const double WallSeconds, const bool bIncludeFiles)
+{
+	FPskImportTimings Timings;
+	FPskImportCounters Counters;
+	auto NumSucceeded = 0;
+	auto NumFromCache = 0;
+	FPskImportMemory PeakMemory;
+	TArray<TSharedPtr<FJsonValue>> Files;
+	for (const auto& Report : Reports)
+	{
+		Timings.Accumulate(Report.Timings);
+		Counters.Accumulate(Report.Counters);
+		NumSucceeded += Report.bSucceeded;
+		NumFromCache += Report.bFromCache;
+		if (Report.Memory.PeakBytes > PeakMemory.PeakBytes)
+		{
+			PeakMemory = Report.Memory;
+		}
+		if (bIncludeFiles)
+		{
+			Files.Add(MakeShared<FJsonValueObject>(Report.ToJson()));
+		}
+	}
+
+	auto Json = MakeShared<FJsonObject>();
+	Json->SetNumberField("files", Reports.Num());
+	Json->SetNumberField("succeeded", NumSucceeded);
+	Json->SetNumberField("failed", Reports.Num() - NumSucceeded);
+	Json->SetNumberField("from_cache", NumFromCache);
+	Json->SetNumberField("wall_seconds", WallSeconds);
+	Json->SetNumberField("files_per_second", WallSeconds > 0.0 ? NumSucceeded / WallSeconds : 0.0);
+	Json->SetNumberField("megabytes_per_second", WallSeconds > 0.0 ? Counters.BytesRead / (1024.0 * 1024.0) / WallSeconds : 0.0);
+	// summed over files, stages running on worker threads overlap so these add up to more than the wall time
+	Json->SetObjectField("seconds", TimingsToJson(Timings));
+	Json->SetObjectField("counters", CountersToJson(Counters));
+	// the file with the highest peak
+	Json->SetObjectField("peak_memory", MemoryToJson(PeakMemory));
+	if (bIncludeFiles)
+	{
+		Json->SetArrayField("file_reports", Files);
+	}
+	return Json;
+}
+
+FString FPskImportReport::ToJsonString(const TSharedRef<FJsonObject>& Json, const bool bPretty)
+{
+	FString Output;
+	if (bPretty)
+	{
+		FJsonSerializer::Serialize(Json, TJsonWriterFactory<>::Create(&Output));
+	}
+	else
+	{
+		FJsonSerializer::Serialize(Json, TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Output));
+	}
+	return Output;
+}
+
+bool FPskImportReport::WriteBatchReport(const TArray<FPskImportReport>& Reports, const double WallSeconds, const FString& Filename)
+{
+	if (!FFileHelper::SaveStringToFile(ToJsonString(MakeBatchJson(Reports, WallSeconds, true), true), *Filename))
+	{
+		UE_LOG(LogUnrealPSKPSA, Error, TEXT("Failed to write import report %s"), *Filename);
+		return false;
+	}
+	
+	UE_LOG(LogUnrealPSKPSA, Display, TEXT("Wrote import report %s"), *Filename);
+	return true;
+}
+
+FString FPskImportReport::GetDefaultReportFilename()
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("PskImport"), FString::Printf(TEXT("ImportReport_%s.json"), *FDateTime::Now().ToString()));
+}
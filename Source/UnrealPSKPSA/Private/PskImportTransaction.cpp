@@ -0,0 +1,147 @@
+﻿#include "PskImportTransaction.h"
+
+#include "ComponentReregisterContext.h"
+#include "StaticMeshCompiler.h"
+#include "UnrealPSKPSA.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Engine/StaticMesh.h"
+
+FPskImportTransaction* FPskImportTransaction::Active = nullptr;
+
+FPskImportTransaction::FPskImportTransaction()
+{
+	check(IsInGameThread());
+	
+	bIsOutermost = Active == nullptr;
+	if (bIsOutermost)
+	{
+		Active = this;
+	}
+}
+
+FPskImportTransaction::~FPskImportTransaction()
+{
+	if (!bIsOutermost) return;
+	
+	Commit();
+	Active = nullptr;
+}
+
+void FPskImportTransaction::AssetChanged(UObject* Asset, const bool bCreated)
+{
+	check(IsInGameThread());
+	if (Asset == nullptr) return;
+	
+	if (Active == nullptr)
+	{
+		FinalizeAsset(Asset, bCreated);
+		return;
+	}
+
+	Active->NumDeferredCalls++;
+	if (const auto Index = Active->PendingIndices.Find(FObjectKey(Asset)))
+	{
+		Active->PendingAssets[*Index].bCreated |= bCreated;
+		return;
+	}
+	
+	Active->PendingIndices.Add(FObjectKey(Asset), Active->PendingAssets.Add({ Asset, bCreated }));
+}
+
+void FPskImportTransaction::ReregisterComponents()
+{
+	check(IsInGameThread());
+	
+	if (Active == nullptr)
+	{
+		FGlobalComponentReregisterContext RecreateComponents;
+		return;
+	}
+
+	Active->bReregisterComponents = true;
+}
+
+void FPskImportTransaction::BuildStaticMesh(UStaticMesh* StaticMesh)
+{
+	check(IsInGameThread());
+	
+	if (Active == nullptr)
+	{
+		StaticMesh->Build();
+		return;
+	}
+
+	Active->PendingStaticMeshes.Add(StaticMesh);
+}
+
+void FPskImportTransaction::Commit()
+{
+	check(IsInGameThread());
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskImportTransaction::Commit);
+
+	// PostEditChange expects built meshes
+	BuildPendingStaticMeshes();
+
+	// in the order the assets were first changed
+	auto NumFinalized = 0;
+	for (const auto& Pending : PendingAssets)
+	{
+		if (const auto Asset = Pending.Asset.Get())
+		{
+			FinalizeAsset(Asset, Pending.bCreated);
+			NumFinalized++;
+		}
+	}
+
+	if (bReregisterComponents)
+	{
+		FGlobalComponentReregisterContext RecreateComponents;
+	}
+
+	if (NumDeferredCalls > 0)
+	{
+		UE_LOG(LogUnrealPSKPSA, Log, TEXT("Finalized %d assets for %d deferred changes%s"), NumFinalized, NumDeferredCalls,
+			bReregisterComponents ? TEXT(", components reregistered once") : TEXT(""));
+	}
+	
+	PendingAssets.Empty();
+	PendingIndices.Empty();
+	NumDeferredCalls = 0;
+	bReregisterComponents = false;
+}
+
+void FPskImportTransaction::BuildPendingStaticMeshes()
+{
+	TArray<UStaticMesh*> StaticMeshes;
+	for (const auto& StaticMesh : PendingStaticMeshes)
+	{
+		if (const auto Mesh = StaticMesh.Get())
+		{
+			StaticMeshes.Add(Mesh);
+		}
+	}
+	PendingStaticMeshes.Empty();
+	if (StaticMeshes.IsEmpty()) return;
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskImportTransaction::BuildStaticMeshes);
+	const auto StartTime = FPlatformTime::Seconds();
+
+	// the meshes build concurrently, on async compilation when it is enabled, which is waited for as well
+	UStaticMesh::BatchBuild(StaticMeshes);
+	FStaticMeshCompilingManager::Get().FinishCompilation(StaticMeshes);
+	
+	const auto Seconds = FPlatformTime::Seconds() - StartTime;
+	StaticMeshBuildSeconds += Seconds;
+	NumStaticMeshesBuilt += StaticMeshes.Num();
+	UE_LOG(LogUnrealPSKPSA, Log, TEXT("Built %d static meshes in %.2fs"), StaticMeshes.Num(), Seconds);
+}
+
+void FPskImportTransaction::FinalizeAsset(UObject* Asset, const bool bCreated)
+{
+	Asset->PostEditChange();
+	if (bCreated)
+	{
+		FAssetRegistryModule::AssetCreated(Asset);
+	}
+	Asset->MarkPackageDirty();
+}
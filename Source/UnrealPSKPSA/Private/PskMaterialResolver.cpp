@@ -0,0 +1,96 @@
+﻿#include "PskMaterialResolver.h"
+
+#include "PskImportTransaction.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Materials/MaterialInstanceConstant.h"
+
+FPskMaterialResolver::FPskMaterialResolver(const TMap<FString, FString>& InMaterialNameToPathMap) : MaterialNameToPathMap(InMaterialNameToPathMap)
+{
+}
+
+FPskMaterialResolver::~FPskMaterialResolver()
+{
+	Flush();
+}
+
+FString FPskMaterialResolver::GetPackageName(const FString& MaterialName, const UObject* Parent) const
+{
+	// same layout FPskPsaUtils::LocalFindOrCreate produces, without creating the parent package just to get its path
+	const auto FoundMaterialPath = MaterialNameToPathMap.Find(MaterialName);
+	const auto ParentPath = FoundMaterialPath != nullptr ? *FoundMaterialPath : Parent->GetPathName();
+	return FPaths::Combine(FPaths::GetPath(ParentPath + "/"), MaterialName);
+}
+
+TArray<UMaterialInterface*> FPskMaterialResolver::Resolve(const TArray<FString>& MaterialNames, const UObject* Parent, const EObjectFlags Flags)
+{
+	check(IsInGameThread());
+	
+	TArray<FString> PackageNames;
+	TArray<FName> PackagesToFind;
+	for (const auto& MaterialName : MaterialNames)
+	{
+		const auto& PackageName = PackageNames.Add_GetRef(GetPackageName(MaterialName, Parent));
+		const auto Found = MaterialsByPackage.Find(PackageName);
+		if (Found == nullptr || !Found->IsValid())
+		{
+			PackagesToFind.AddUnique(FName(PackageName));
+		}
+	}
+
+	if (PackagesToFind.Num() > 0)
+	{
+		const auto& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+		
+		FARFilter Filter;
+		Filter.PackageNames = PackagesToFind;
+		
+		TArray<FAssetData> Assets;
+		AssetRegistry.GetAssets(Filter, Assets);
+		for (const auto& Asset : Assets)
+		{
+			if (!Asset.GetClass() || !Asset.GetClass()->IsChildOf(UMaterialInterface::StaticClass())) continue;
+			
+			if (const auto Material = Cast<UMaterialInterface>(Asset.GetAsset()))
+			{
+				MaterialsByPackage.Add(Asset.PackageName.ToString(), Material);
+			}
+		}
+	}
+
+	TArray<UMaterialInterface*> Materials;
+	for (auto i = 0; i < MaterialNames.Num(); i++)
+	{
+		const auto& MaterialName = MaterialNames[i];
+		const auto& PackageName = PackageNames[i];
+		
+		auto& Material = MaterialsByPackage.FindOrAdd(PackageName);
+		if (!Material.IsValid())
+		{
+			// the registry may still be discovering assets, fall back to loading before creating a duplicate
+			const auto Package = CreatePackage(*PackageName);
+			Material = LoadObject<UMaterialInterface>(Package, *MaterialName, nullptr, LOAD_NoWarn | LOAD_Quiet);
+			if (!Material.IsValid())
+			{
+				const auto NewMaterial = NewObject<UMaterialInstanceConstant>(Package, UMaterialInstanceConstant::StaticClass(), FName(MaterialName), Flags);
+				PendingMaterials.Add(NewMaterial);
+				Material = NewMaterial;
+			}
+		}
+		
+		Materials.Add(Material.Get());
+	}
+
+	return Materials;
+}
+
+void FPskMaterialResolver::Flush()
+{
+	for (const auto& WeakMaterial : PendingMaterials)
+	{
+		if (const auto Material = WeakMaterial.Get())
+		{
+			FPskImportTransaction::AssetChanged(Material, true);
+		}
+	}
+	PendingMaterials.Empty();
+}
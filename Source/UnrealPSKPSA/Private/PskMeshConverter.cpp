@@ -0,0 +1,618 @@
+﻿#include "PskMeshConverter.h"
+
+#include "PskAssetImportData.h"
+#include "PskImportDataCache.h"
+#include "StaticMeshAttributes.h"
+#include "Algo/Find.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Rendering/SkeletalMeshLODImporterData.h"
+#include <atomic>
+
+// large enough to amortize task overhead, a multiple of four so mirror batches stay on whole vector registers
+constexpr int32 ConversionBatchSize = 16384;
+
+static TAutoConsoleVariable<int32> CVarPskTangentMethod(
+	TEXT("psk.TangentMethod"),
+	0,
+	TEXT("How tangents of psk and pskx files without VTXTANGS are made. 0: the mesh builder runs MikkTSpace, 1: a parallel generator runs while converting."));
+
+// the chunks generated tangents are computed from, uvs are taken from the wedges
+static const TCHAR* const TangentInputChunkNames[] = { TEXT("PNTS0000"), TEXT("VTXW0000"), TEXT("FACE0000"), TEXT("FACE3200"), TEXT("VTXNORMS") };
+
+// influences carrying less than this share of their point's weight are export noise, skinning gains nothing from them
+constexpr float InfluenceWeightThreshold = 1.e-3f;
+
+template <typename FuncType>
+static void ParallelForBatches(const int32 Num, FuncType&& Func)
+{
+	const auto NumBatches = FMath::DivideAndRoundUp(Num, ConversionBatchSize);
+	ParallelFor(NumBatches, [&](const int32 BatchIndex)
+	{
+		const auto Start = BatchIndex * ConversionBatchSize;
+		Func(Start, FMath::Min(Start + ConversionBatchSize, Num));
+	});
+}
+
+// copies vectors and negates their Y, four vectors (three registers) per iteration
+static void CopyMirrored(const FVector3f* Source, FVector3f* Dest, const int32 Num)
+{
+	const auto SourceFloats = reinterpret_cast<const float*>(Source);
+	const auto DestFloats = reinterpret_cast<float*>(Dest);
+	const auto NumFloats = Num * 3;
+
+	// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+	const VectorRegister4Float Signs[3] =
+	{
+		MakeVectorRegisterFloat(1.0f, -1.0f, 1.0f, 1.0f),
+		MakeVectorRegisterFloat(-1.0f, 1.0f, 1.0f, -1.0f),
+		MakeVectorRegisterFloat(1.0f, 1.0f, -1.0f, 1.0f)
+	};
+
+	auto i = 0;
+	for (; i + 12 <= NumFloats; i += 12)
+	{
+		for (auto j = 0; j < 3; j++)
+		{
+			const auto Offset = i + j * 4;
+			VectorStore(VectorMultiply(VectorLoad(SourceFloats + Offset), Signs[j]), DestFloats + Offset);
+		}
+	}
+	
+	for (; i < NumFloats; i++)
+	{
+		DestFloats[i] = i % 3 == 1 ? -SourceFloats[i] : SourceFloats[i];
+	}
+}
+
+static void CopyMirrored(const TConstArrayView<FVector3f> Source, TArray<FVector3f>& Dest)
+{
+	Dest.SetNumUninitialized(Source.Num());
+	ParallelForBatches(Source.Num(), [&](const int32 Start, const int32 End)
+	{
+		CopyMirrored(Source.GetData() + Start, Dest.GetData() + Start, End - Start);
+	});
+}
+
+/*
+ * Tangent frames of every face from uv0, summed over the faces sharing a psk wedge and orthogonalized against the
+ * wedge normal. Faces contribute in proportion to their area, so slivers barely move the wedges they share.
+ */
+static void GenerateTangents(FPskMeshBuffers& Buffers)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskMeshConverter::GenerateTangents);
+
+	const auto NumFaces = Buffers.NumFaces();
+	const auto NumCorners = Buffers.NumCorners();
+	const auto NumWedges = Buffers.NumWedges;
+
+	const auto GetPosition = [&Buffers](const int32 CornerIndex) -> const FVector3f&
+	{
+		return Buffers.Positions[Buffers.bSharesWedges ? Buffers.WedgePoints[Buffers.CornerWedges[CornerIndex]] : Buffers.CornerPoints[CornerIndex]];
+	};
+	const auto GetUV = [&Buffers](const int32 CornerIndex) -> const FVector2f&
+	{
+		return Buffers.bSharesWedges ? Buffers.WedgeUVs[0][Buffers.CornerWedges[CornerIndex]] : Buffers.CornerUVs[0][CornerIndex];
+	};
+
+	TArray<FVector3f> FaceTangents;
+	TArray<FVector3f> FaceBitangents;
+	FaceTangents.SetNumUninitialized(NumFaces);
+	FaceBitangents.SetNumUninitialized(NumFaces);
+	ParallelForBatches(NumFaces, [&](const int32 Start, const int32 End)
+	{
+		for (auto FaceIndex = Start; FaceIndex < End; FaceIndex++)
+		{
+			const auto Corner = FaceIndex * 3;
+			const auto Edge1 = GetPosition(Corner + 1) - GetPosition(Corner);
+			const auto Edge2 = GetPosition(Corner + 2) - GetPosition(Corner);
+			const auto DeltaUV1 = GetUV(Corner + 1) - GetUV(Corner);
+			const auto DeltaUV2 = GetUV(Corner + 2) - GetUV(Corner);
+
+			// only the orientation of the uvs matters, their scale would weight faces by texel density. Faces without uv
+			// area do not tell which way the uvs run and contribute nothing
+			const auto Determinant = DeltaUV1.X * DeltaUV2.Y - DeltaUV2.X * DeltaUV1.Y;
+			const auto Weight = FVector3f::CrossProduct(Edge1, Edge2).Size() * FMath::Sign(Determinant);
+			FaceTangents[FaceIndex] = (Edge1 * DeltaUV2.Y - Edge2 * DeltaUV1.Y).GetSafeNormal() * Weight;
+			FaceBitangents[FaceIndex] = (Edge2 * DeltaUV1.X - Edge1 * DeltaUV2.X).GetSafeNormal() * Weight;
+		}
+	});
+
+	// corners grouped by the wedge they use
+	TArray<int32> WedgeOffsets;
+	WedgeOffsets.SetNumZeroed(NumWedges + 1);
+	for (const auto WedgeIndex : Buffers.CornerWedges)
+	{
+		WedgeOffsets[WedgeIndex + 1]++;
+	}
+	for (auto WedgeIndex = 0; WedgeIndex < NumWedges; WedgeIndex++)
+	{
+		WedgeOffsets[WedgeIndex + 1] += WedgeOffsets[WedgeIndex];
+	}
+	
+	TArray<int32> WedgeCorners;
+	WedgeCorners.SetNumUninitialized(NumCorners);
+	{
+		TArray<int32> Cursors(WedgeOffsets.GetData(), NumWedges);
+		for (auto CornerIndex = 0; CornerIndex < NumCorners; CornerIndex++)
+		{
+			WedgeCorners[Cursors[Buffers.CornerWedges[CornerIndex]]++] = CornerIndex;
+		}
+	}
+
+	TArray<FVector4f> WedgeTangents;
+	WedgeTangents.SetNumUninitialized(NumWedges);
+	ParallelForBatches(NumWedges, [&](const int32 Start, const int32 End)
+	{
+		for (auto WedgeIndex = Start; WedgeIndex < End; WedgeIndex++)
+		{
+			auto Tangent = FVector3f::ZeroVector;
+			auto Bitangent = FVector3f::ZeroVector;
+			auto Normal = FVector3f::ZeroVector;
+			for (auto Index = WedgeOffsets[WedgeIndex]; Index < WedgeOffsets[WedgeIndex + 1]; Index++)
+			{
+				const auto CornerIndex = WedgeCorners[Index];
+				Tangent += FaceTangents[CornerIndex / 3];
+				Bitangent += FaceBitangents[CornerIndex / 3];
+				// normals are per point, every corner of a wedge has the same one
+				Normal = Buffers.CornerNormals[CornerIndex];
+			}
+			Normal.Normalize();
+
+			// wedges without a usable uv direction get any tangent perpendicular to their normal
+			Tangent -= Normal * FVector3f::DotProduct(Normal, Tangent);
+			if (!Tangent.Normalize())
+			{
+				Normal.FindBestAxisVectors(Tangent, Bitangent);
+			}
+			
+			const auto BinormalSign = FVector3f::DotProduct(FVector3f::CrossProduct(Normal, Tangent), Bitangent) < 0.0f ? -1.0f : 1.0f;
+			WedgeTangents[WedgeIndex] = FVector4f(Tangent, BinormalSign);
+		}
+	});
+
+	Buffers.CornerTangents.SetNumUninitialized(NumCorners);
+	ParallelForBatches(NumCorners, [&](const int32 Start, const int32 End)
+	{
+		for (auto CornerIndex = Start; CornerIndex < End; CornerIndex++)
+		{
+			Buffers.CornerTangents[CornerIndex] = WedgeTangents[Buffers.CornerWedges[CornerIndex]];
+		}
+	});
+}
+
+// every later stage indexes points through wedges and wedges through faces without checking, inside ParallelFor
+static bool HasValidIndices(const TConstArrayView<VVertex> Wedges, const TConstArrayView<VTriangle> Faces, const int32 NumPoints)
+{
+	std::atomic<bool> bValid { true };
+	ParallelForBatches(Wedges.Num(), [&](const int32 Start, const int32 End)
+	{
+		for (auto WedgeIndex = Start; WedgeIndex < End; WedgeIndex++)
+		{
+			if (static_cast<uint32>(Wedges[WedgeIndex].PointIndex) >= static_cast<uint32>(NumPoints))
+			{
+				bValid = false;
+				return;
+			}
+		}
+	});
+	ParallelForBatches(Faces.Num(), [&](const int32 Start, const int32 End)
+	{
+		for (auto FaceIndex = Start; FaceIndex < End; FaceIndex++)
+		{
+			for (const auto WedgeIndex : Faces[FaceIndex].WedgeIndex)
+			{
+				if (static_cast<uint32>(WedgeIndex) >= static_cast<uint32>(Wedges.Num()))
+				{
+					bValid = false;
+					return;
+				}
+			}
+		}
+	});
+	return bValid;
+}
+
+bool FPskMeshConverter::Convert(FPskReader& Reader, FPskMeshBuffers& OutBuffers, const bool bShareWedges)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskMeshConverter::Convert);
+	
+	const auto Wedges = Reader.GetWedges();
+	const auto Faces = Reader.GetFaces();
+	if (!HasValidIndices(Wedges, Faces, Reader.GetVertices().Num())) return false;
+	
+	const auto VertexColors = Reader.GetVertexColors();
+	const auto& ExtraUVs = Reader.GetExtraUVs();
+	
+	OutBuffers.bHasNormals = Reader.HasVertexNormals();
+	OutBuffers.bHasTangents = Reader.HasVertexTangents() && OutBuffers.bHasNormals;
+	OutBuffers.bHasColors = Reader.HasVertexColors();
+	OutBuffers.bSharesWedges = bShareWedges;
+	OutBuffers.NumWedges = Wedges.Num();
+	OutBuffers.NumUVChannels = 1 + ExtraUVs.Num();
+	
+	CopyMirrored(Reader.GetVertices(), OutBuffers.Positions);
+
+	TArray<FVector3f> PointNormals;
+	if (OutBuffers.bHasNormals)
+	{
+		CopyMirrored(Reader.GetNormals(), PointNormals);
+	}
+	const auto Tangents = OutBuffers.bHasTangents ? Reader.GetTangents() : TConstArrayView<FVector4f>();
+
+	// colors are shared by every wedge of a point and the last wedge wins, so this scatter stays serial
+	TArray<FColor> PointColors;
+	if (OutBuffers.bHasColors)
+	{
+		PointColors.Init(FColor::Black, OutBuffers.Positions.Num());
+		for (auto i = 0; i < Wedges.Num(); i++)
+		{
+			auto FixedColor = VertexColors[i];
+			Swap(FixedColor.R, FixedColor.B);
+			PointColors[Wedges[i].PointIndex] = FixedColor;
+		}
+	}
+
+	if (bShareWedges)
+	{
+		const auto NumWedges = Wedges.Num();
+		OutBuffers.WedgePoints.SetNumUninitialized(NumWedges);
+		OutBuffers.WedgeMaterials.SetNumUninitialized(NumWedges);
+		OutBuffers.WedgeColors.SetNumUninitialized(NumWedges);
+		OutBuffers.WedgeUVs.SetNum(OutBuffers.NumUVChannels);
+		for (auto& UVs : OutBuffers.WedgeUVs)
+		{
+			UVs.SetNumUninitialized(NumWedges);
+		}
+		
+		ParallelForBatches(NumWedges, [&](const int32 Start, const int32 End)
+		{
+			for (auto WedgeIndex = Start; WedgeIndex < End; WedgeIndex++)
+			{
+				const auto& PskWedge = Wedges[WedgeIndex];
+				OutBuffers.WedgePoints[WedgeIndex] = PskWedge.PointIndex;
+				OutBuffers.WedgeMaterials[WedgeIndex] = static_cast<uint8>(PskWedge.MatIndex);
+				OutBuffers.WedgeColors[WedgeIndex] = OutBuffers.bHasColors ? PointColors[PskWedge.PointIndex] : FColor::Black;
+				OutBuffers.WedgeUVs[0][WedgeIndex] = FVector2f(PskWedge.U, PskWedge.V);
+				for (auto UVIndex = 0; UVIndex < ExtraUVs.Num(); UVIndex++)
+				{
+					OutBuffers.WedgeUVs[UVIndex + 1][WedgeIndex] = ExtraUVs[UVIndex][WedgeIndex];
+				}
+			}
+		});
+	}
+
+	const auto NumFaces = Faces.Num();
+	const auto NumCorners = NumFaces * 3;
+	OutBuffers.FaceMaterials.SetNumUninitialized(NumFaces);
+	OutBuffers.CornerWedges.SetNumUninitialized(NumCorners);
+	OutBuffers.CornerNormals.SetNumUninitialized(NumCorners);
+	if (OutBuffers.bHasTangents)
+	{
+		OutBuffers.CornerTangents.SetNumUninitialized(NumCorners);
+	}
+	if (!bShareWedges)
+	{
+		OutBuffers.CornerPoints.SetNumUninitialized(NumCorners);
+		OutBuffers.CornerColors.SetNumUninitialized(NumCorners);
+		OutBuffers.CornerUVs.SetNum(OutBuffers.NumUVChannels);
+		for (auto& UVs : OutBuffers.CornerUVs)
+		{
+			UVs.SetNumUninitialized(NumCorners);
+		}
+	}
+
+	ParallelForBatches(NumFaces, [&](const int32 Start, const int32 End)
+	{
+		for (auto FaceIndex = Start; FaceIndex < End; FaceIndex++)
+		{
+			const auto& PskFace = Faces[FaceIndex];
+			OutBuffers.FaceMaterials[FaceIndex] = static_cast<uint8>(PskFace.MatIndex);
+
+			// psk faces wind the other way around, corner k of the output face is corner 2 - k of the psk face
+			for (auto Corner = 0; Corner < 3; Corner++)
+			{
+				const auto CornerIndex = FaceIndex * 3 + Corner;
+				const auto WedgeIndex = PskFace.WedgeIndex[2 - Corner];
+				const auto& PskWedge = Wedges[WedgeIndex];
+
+				OutBuffers.CornerWedges[CornerIndex] = WedgeIndex;
+				OutBuffers.CornerNormals[CornerIndex] = OutBuffers.bHasNormals ? PointNormals[PskWedge.PointIndex] : FVector3f::ZeroVector;
+				if (OutBuffers.bHasTangents)
+				{
+					// mirroring flips the handedness of the tangent basis along with Y
+					const auto& Tangent = Tangents[WedgeIndex];
+					OutBuffers.CornerTangents[CornerIndex] = FVector4f(Tangent.X, -Tangent.Y, Tangent.Z, -Tangent.W);
+				}
+				if (bShareWedges) continue;
+				
+				OutBuffers.CornerPoints[CornerIndex] = PskWedge.PointIndex;
+				OutBuffers.CornerColors[CornerIndex] = OutBuffers.bHasColors ? PointColors[PskWedge.PointIndex] : FColor::Black;
+				OutBuffers.CornerUVs[0][CornerIndex] = FVector2f(PskWedge.U, PskWedge.V);
+				for (auto UVIndex = 0; UVIndex < ExtraUVs.Num(); UVIndex++)
+				{
+					OutBuffers.CornerUVs[UVIndex + 1][CornerIndex] = ExtraUVs[UVIndex][WedgeIndex];
+				}
+			}
+		}
+	});
+	return true;
+}
+
+EPskTangentMethod FPskMeshConverter::GetTangentMethod()
+{
+	return CVarPskTangentMethod.GetValueOnAnyThread() == 1 ? EPskTangentMethod::Fast : EPskTangentMethod::MikkTSpace;
+}
+
+void FPskMeshConverter::FindOrGenerateTangents(FPskMeshBuffers& Buffers, const TArray<FPskChunkHash>& ChunkHashes, const FString& Filename)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskMeshConverter::FindOrGenerateTangents);
+	if (Buffers.bHasTangents || !Buffers.bHasNormals) return;
+
+	const auto InputHash = UPskAssetImportData::GetContentHash(ChunkHashes.FilterByPredicate([](const FPskChunkHash& ChunkHash)
+	{
+		return Algo::Find(TangentInputChunkNames, ChunkHash.ChunkName) != nullptr;
+	}));
+	
+	Buffers.bHasTangents = true;
+	if (FPskImportDataCache::GetTangents(InputHash, Filename, Buffers.CornerTangents) && Buffers.CornerTangents.Num() == Buffers.NumCorners()) return;
+
+	GenerateTangents(Buffers);
+	FPskImportDataCache::PutTangents(InputHash, Filename, Buffers.CornerTangents);
+}
+
+void FPskMeshConverter::ToSkeletalMeshImportData(FPskMeshBuffers& Buffers, FSkeletalMeshImportData& OutImportData)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskMeshConverter::ToSkeletalMeshImportData);
+	check(Buffers.bSharesWedges);
+	
+	const auto NumPoints = Buffers.Positions.Num();
+	const auto NumFaces = Buffers.NumFaces();
+	
+	OutImportData.PointToRawMap.SetNumUninitialized(NumPoints);
+	ParallelForBatches(NumPoints, [&](const int32 Start, const int32 End)
+	{
+		for (auto i = Start; i < End; i++)
+		{
+			OutImportData.PointToRawMap[i] = i;
+		}
+	});
+	OutImportData.Points = MoveTemp(Buffers.Positions);
+
+	// one import wedge per psk wedge, the builder no longer has to weld three wedges per face back together. Wedges and
+	// faces are filled in separate passes so the buffers each pass consumes are freed before the next grows
+	const auto NumWedges = Buffers.WedgePoints.Num();
+	OutImportData.Wedges.SetNum(NumWedges);
+	ParallelForBatches(NumWedges, [&](const int32 Start, const int32 End)
+	{
+		for (auto WedgeIndex = Start; WedgeIndex < End; WedgeIndex++)
+		{
+			auto& Wedge = OutImportData.Wedges[WedgeIndex];
+			Wedge.MatIndex = Buffers.WedgeMaterials[WedgeIndex];
+			Wedge.VertexIndex = Buffers.WedgePoints[WedgeIndex];
+			Wedge.Color = Buffers.WedgeColors[WedgeIndex];
+			for (auto UVIndex = 0; UVIndex < Buffers.WedgeUVs.Num() && UVIndex < MAX_TEXCOORDS; UVIndex++)
+			{
+				Wedge.UVs[UVIndex] = Buffers.WedgeUVs[UVIndex][WedgeIndex];
+			}
+		}
+	});
+	Buffers.WedgePoints.Empty();
+	Buffers.WedgeMaterials.Empty();
+	Buffers.WedgeColors.Empty();
+	Buffers.WedgeUVs.Empty();
+
+	OutImportData.Faces.SetNum(NumFaces);
+	ParallelForBatches(NumFaces, [&](const int32 Start, const int32 End)
+	{
+		for (auto FaceIndex = Start; FaceIndex < End; FaceIndex++)
+		{
+			auto& Face = OutImportData.Faces[FaceIndex];
+			Face.MatIndex = Buffers.FaceMaterials[FaceIndex];
+			Face.SmoothingGroups = 1;
+			Face.AuxMatIndex = 0;
+			
+			for (auto Corner = 0; Corner < 3; Corner++)
+			{
+				const auto CornerIndex = FaceIndex * 3 + Corner;
+				Face.WedgeIndex[Corner] = Buffers.CornerWedges[CornerIndex];
+				Face.TangentZ[Corner] = Buffers.CornerNormals[CornerIndex];
+				if (Buffers.bHasTangents)
+				{
+					const auto& Tangent = Buffers.CornerTangents[CornerIndex];
+					Face.TangentX[Corner] = FVector3f(Tangent);
+					Face.TangentY[Corner] = FVector3f::CrossProduct(Face.TangentZ[Corner], Face.TangentX[Corner]) * Tangent.W;
+				}
+				else
+				{
+					Face.TangentY[Corner] = FVector3f::ZeroVector;
+					Face.TangentX[Corner] = FVector3f::ZeroVector;
+				}
+			}
+		}
+	});
+	Buffers.CornerWedges.Empty();
+	Buffers.CornerNormals.Empty();
+	Buffers.CornerTangents.Empty();
+	Buffers.FaceMaterials.Empty();
+}
+
+void FPskMeshConverter::ToMeshDescription(FPskMeshBuffers& Buffers, const TArray<FString>& MaterialNames, FMeshDescription& OutMeshDescription)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskMeshConverter::ToMeshDescription);
+	check(!Buffers.bSharesWedges);
+	
+	const auto NumPoints = Buffers.Positions.Num();
+	const auto NumCorners = Buffers.NumCorners();
+	const auto NumFaces = Buffers.NumFaces();
+
+	FStaticMeshAttributes Attributes(OutMeshDescription);
+	Attributes.Register();
+	
+	OutMeshDescription.ReserveNewVertices(NumPoints);
+	OutMeshDescription.ReserveNewVertexInstances(NumCorners);
+	OutMeshDescription.ReserveNewTriangles(NumFaces);
+	OutMeshDescription.ReserveNewEdges(NumCorners);
+
+	// elements of a fresh description are numbered in creation order, so attributes can be filled as raw arrays
+	for (auto i = 0; i < NumPoints; i++)
+	{
+		OutMeshDescription.CreateVertex();
+	}
+	for (auto i = 0; i < NumCorners; i++)
+	{
+		OutMeshDescription.CreateVertexInstance(FVertexID(Buffers.CornerPoints[i]));
+	}
+	Buffers.CornerWedges.Empty();
+	Buffers.CornerPoints.Empty();
+
+	auto VertexPositions = Attributes.GetVertexPositions().GetRawArray();
+	FMemory::Memcpy(VertexPositions.GetData(), Buffers.Positions.GetData(), NumPoints * sizeof(FVector3f));
+	Buffers.Positions.Empty();
+
+	auto VertexInstanceUVs = Attributes.GetVertexInstanceUVs();
+	VertexInstanceUVs.SetNumChannels(FMath::Min(Buffers.CornerUVs.Num(), static_cast<int32>(MAX_MESH_TEXTURE_COORDS_MD)));
+	for (auto UVIndex = 0; UVIndex < VertexInstanceUVs.GetNumChannels(); UVIndex++)
+	{
+		auto UVs = VertexInstanceUVs.GetRawArray(UVIndex);
+		FMemory::Memcpy(UVs.GetData(), Buffers.CornerUVs[UVIndex].GetData(), NumCorners * sizeof(FVector2f));
+	}
+	Buffers.CornerUVs.Empty();
+
+	auto Normals = Attributes.GetVertexInstanceNormals().GetRawArray();
+	auto Tangents = Attributes.GetVertexInstanceTangents().GetRawArray();
+	auto BinormalSigns = Attributes.GetVertexInstanceBinormalSigns().GetRawArray();
+	auto Colors = Attributes.GetVertexInstanceColors().GetRawArray();
+	ParallelForBatches(NumCorners, [&](const int32 Start, const int32 End)
+	{
+		for (auto i = Start; i < End; i++)
+		{
+			Normals[i] = Buffers.CornerNormals[i];
+			Tangents[i] = Buffers.bHasTangents ? FVector3f(Buffers.CornerTangents[i]) : FVector3f::ZeroVector;
+			BinormalSigns[i] = Buffers.bHasTangents ? Buffers.CornerTangents[i].W : 1.0f;
+			Colors[i] = FVector4f(FLinearColor::FromSRGBColor(Buffers.CornerColors[i]));
+		}
+	});
+	Buffers.CornerNormals.Empty();
+	Buffers.CornerTangents.Empty();
+	Buffers.CornerColors.Empty();
+
+	// faces may reference materials past the end of the material list, give those a group too
+	auto NumGroups = MaterialNames.Num();
+	for (const auto MaterialIndex : Buffers.FaceMaterials)
+	{
+		NumGroups = FMath::Max(NumGroups, MaterialIndex + 1);
+	}
+	
+	auto PolygonGroupSlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+	for (auto GroupIndex = 0; GroupIndex < NumGroups; GroupIndex++)
+	{
+		const auto PolygonGroupID = OutMeshDescription.CreatePolygonGroup();
+		PolygonGroupSlotNames[PolygonGroupID] = MaterialNames.IsValidIndex(GroupIndex) ? FName(MaterialNames[GroupIndex]) : FName(FString::Printf(TEXT("MaterialSlot_%d"), GroupIndex));
+	}
+
+	for (auto FaceIndex = 0; FaceIndex < NumFaces; FaceIndex++)
+	{
+		const FVertexInstanceID Corners[3] = { FVertexInstanceID(FaceIndex * 3), FVertexInstanceID(FaceIndex * 3 + 1), FVertexInstanceID(FaceIndex * 3 + 2) };
+		OutMeshDescription.CreateTriangle(FPolygonGroupID(Buffers.FaceMaterials[FaceIndex]), MakeArrayView(Corners));
+	}
+}
+
+int32 FPskMeshConverter::NormalizeInfluences(TConstArrayView<VRawBoneInfluence> Influences, TConstArrayView<int32> BoneRemap, const int32 NumPoints,
+											 const int32 MaxInfluences, TArray<SkeletalMeshImportData::FRawBoneInfluence>& OutInfluences)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskMeshConverter::NormalizeInfluences);
+
+	const auto IsUsable = [&](const VRawBoneInfluence& Influence)
+	{
+		return Influence.PointIdx >= 0 && Influence.PointIdx < NumPoints && BoneRemap.IsValidIndex(Influence.BoneIdx);
+	};
+	
+	// counting sort into one bucket per point, buckets keep the file order of their influences
+	TArray<int32> BucketOffsets;
+	BucketOffsets.SetNumZeroed(NumPoints + 1);
+	for (const auto& Influence : Influences)
+	{
+		if (IsUsable(Influence)) BucketOffsets[Influence.PointIdx + 1]++;
+	}
+	for (auto PointIndex = 0; PointIndex < NumPoints; PointIndex++)
+	{
+		BucketOffsets[PointIndex + 1] += BucketOffsets[PointIndex];
+	}
+
+	TArray<SkeletalMeshImportData::FRawBoneInfluence> Buckets;
+	Buckets.SetNumUninitialized(BucketOffsets[NumPoints]);
+	{
+		TArray<int32> Cursors(BucketOffsets.GetData(), NumPoints);
+		for (const auto& Influence : Influences)
+		{
+			if (!IsUsable(Influence)) continue;
+
+			auto& Bucketed = Buckets[Cursors[Influence.PointIdx]++];
+			Bucketed.VertexIndex = Influence.PointIdx;
+			Bucketed.BoneIndex = BoneRemap[Influence.BoneIdx];
+			Bucketed.Weight = FMath::Max(Influence.Weight, 0.f);
+		}
+	}
+
+	// every bucket is reduced in place, its kept influences end up at its start
+	TArray<int32> KeptOffsets;
+	KeptOffsets.SetNumZeroed(NumPoints + 1);
+	ParallelForBatches(NumPoints, [&](const int32 Start, const int32 End)
+	{
+		for (auto PointIndex = Start; PointIndex < End; PointIndex++)
+		{
+			const auto Bucket = Buckets.GetData() + BucketOffsets[PointIndex];
+			const auto NumInBucket = BucketOffsets[PointIndex + 1] - BucketOffsets[PointIndex];
+
+			// a bone listed twice, or two psk bones collapsed onto one by BoneRemap, is a single influence
+			auto NumMerged = 0;
+			for (auto Index = 0; Index < NumInBucket; Index++)
+			{
+				auto MergedIndex = 0;
+				while (MergedIndex < NumMerged && Bucket[MergedIndex].BoneIndex != Bucket[Index].BoneIndex) MergedIndex++;
+				
+				if (MergedIndex < NumMerged) Bucket[MergedIndex].Weight += Bucket[Index].Weight;
+				else Bucket[NumMerged++] = Bucket[Index];
+			}
+
+			// ties go to the lower bone so the order does not depend on the file order
+			Algo::Sort(MakeArrayView(Bucket, NumMerged), [](const auto& A, const auto& B)
+			{
+				return A.Weight != B.Weight ? A.Weight > B.Weight : A.BoneIndex < B.BoneIndex;
+			});
+
+			auto Total = 0.f;
+			for (auto Index = 0; Index < NumMerged; Index++) Total += Bucket[Index].Weight;
+			
+			// the strongest influence always stays, points without any weight are left to the builder to bind to the root
+			auto NumKept = Total > 0.f ? FMath::Min(NumMerged, MaxInfluences) : 0;
+			while (NumKept > 1 && Bucket[NumKept - 1].Weight < Total * InfluenceWeightThreshold) NumKept--;
+
+			auto KeptTotal = 0.f;
+			for (auto Index = 0; Index < NumKept; Index++) KeptTotal += Bucket[Index].Weight;
+			for (auto Index = 0; Index < NumKept; Index++) Bucket[Index].Weight /= KeptTotal;
+
+			KeptOffsets[PointIndex + 1] = NumKept;
+		}
+	});
+	
+	for (auto PointIndex = 0; PointIndex < NumPoints; PointIndex++)
+	{
+		KeptOffsets[PointIndex + 1] += KeptOffsets[PointIndex];
+	}
+
+	OutInfluences.SetNumUninitialized(KeptOffsets[NumPoints]);
+	ParallelForBatches(NumPoints, [&](const int32 Start, const int32 End)
+	{
+		for (auto PointIndex = Start; PointIndex < End; PointIndex++)
+		{
+			FMemory::Memcpy(OutInfluences.GetData() + KeptOffsets[PointIndex], Buckets.GetData() + BucketOffsets[PointIndex],
+							(KeptOffsets[PointIndex + 1] - KeptOffsets[PointIndex]) * sizeof(SkeletalMeshImportData::FRawBoneInfluence));
+		}
+	});
+
+	return Influences.Num() - OutInfluences.Num();
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+#include "PskReader.h"
+
+struct FMeshDescription;
+struct FPskChunkHash;
+struct FSkeletalMeshImportData;
+namespace SkeletalMeshImportData { struct FRawBoneInfluence; }
+
+/*
+ * Geometry of a psk in structure of arrays form, mirrored (MIRROR_MESH) and with the face winding reversed.
+ * Corners are stored three per face in the winding the engine expects. Vertex attributes are either stored once per
+ * psk wedge, with corners referencing the wedge they use, or expanded to every corner.
+ */
+struct FPskMeshBuffers
+{
+	TArray<FVector3f> Positions;
+
+	// filled when wedges are shared
+	TArray<uint32> WedgePoints;
+	TArray<uint8> WedgeMaterials;
+	TArray<FColor> WedgeColors;
+	TArray<TArray<FVector2f>> WedgeUVs;
+	
+	TArray<int32> CornerWedges;
+	TArray<FVector3f> CornerNormals;
+	// only filled along with normals, w is the binormal sign
+	TArray<FVector4f> CornerTangents;
+	
+	// filled when wedges are expanded to corners
+	TArray<uint32> CornerPoints;
+	TArray<FColor> CornerColors;
+	TArray<TArray<FVector2f>> CornerUVs;
+
+	TArray<int32> FaceMaterials;
+
+	int32 NumWedges = 0;
+	int32 NumUVChannels = 0;
+	bool bHasNormals = false;
+	bool bHasTangents = false;
+	bool bHasColors = false;
+	bool bSharesWedges = false;
+
+	int32 NumFaces() const { return FaceMaterials.Num(); }
+	int32 NumCorners() const { return CornerWedges.Num(); }
+};
+
+enum class EPskTangentMethod : uint8
+{
+	// the mesh builder recomputes tangents with MikkTSpace
+	MikkTSpace,
+	// tangents are generated in parallel during conversion and kept by the builder
+	Fast
+};
+
+/*
+ * Conversion shared by the skeletal and static mesh importers. Every stage fills preallocated arrays with
+ * ParallelFor, the mirror transform runs four floats at a time on vector registers.
+ */
+class FPskMeshConverter
+{
+public:
+	// bShareWedges keeps one set of vertex attributes per psk wedge instead of expanding them to every face corner
+	// tangents of the file are kept whenever it has normals as well, the builder is left to recompute them otherwise.
+	// False if a wedge or face indexes past the points or wedges of the file, nothing is converted then
+	static bool Convert(FPskReader& Reader, FPskMeshBuffers& OutBuffers, const bool bShareWedges);
+
+	// psk.TangentMethod, read once per import
+	static EPskTangentMethod GetTangentMethod();
+	// fills tangents of buffers that have normals but no tangents. Generated tangents are cached by the chunks they
+	// depend on, a file whose bones, weights or materials changed since the last import reuses them
+	static void FindOrGenerateTangents(FPskMeshBuffers& Buffers, const TArray<FPskChunkHash>& ChunkHashes, const FString& Filename);
+	
+	// fills points, wedges and faces; bones, influences and materials are left to the caller. Buffers are moved from or
+	// freed as soon as they are consumed, the reader may be released before calling either of these
+	static void ToSkeletalMeshImportData(FPskMeshBuffers& Buffers, FSkeletalMeshImportData& OutImportData);
+	// one polygon group per material, slot names are the material names. Needs buffers with wedges expanded to corners
+	static void ToMeshDescription(FPskMeshBuffers& Buffers, const TArray<FString>& MaterialNames, FMeshDescription& OutMeshDescription);
+	
+	// groups influences by point, merges repeated bones, keeps the MaxInfluences strongest that are not negligible and
+	// renormalizes them. The result is ordered by point, then by descending weight; bones are mapped through BoneRemap
+	// and influences of unknown bones or points are dropped. Returns how many input influences did not make it
+	static int32 NormalizeInfluences(TConstArrayView<VRawBoneInfluence> Influences, TConstArrayView<int32> BoneRemap, const int32 NumPoints,
+									 const int32 MaxInfluences, TArray<SkeletalMeshImportData::FRawBoneInfluence>& OutInfluences);
+};
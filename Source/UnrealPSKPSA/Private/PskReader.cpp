@@ -1,165 +1,328 @@
 ﻿#include "PskReader.h"
 
-#include <fstream>
-
 #include "UnrealPSKPSA.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 
-FPskReader::FPskReader(const FString& Filepath)
+// on-disk element sizes of chunks that are packed differently from their in-memory struct
+constexpr int32 PackedFace16Size = ActorX::PackedSize::Face16;
+constexpr int32 PackedFace32Size = ActorX::PackedSize::Face32;
+constexpr int32 PackedBoneSize = ActorX::PackedSize::Bone;
+
+FPskMappedFile::~FPskMappedFile()
 {
-	std::ifstream Ar;
-	Ar.open(ToCStr(Filepath), std::ios::binary);
+	// the region has to be released before the handle it was mapped from
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+}
 
-	const FPskHeader MainHeader(Ar);
-	if (!MainHeader.ChunkName.Equals("ACTRHEAD"))
+bool FPskMappedFile::Open(const FString& Filepath)
+{
+	auto& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedHandle.Reset(PlatformFile.OpenMapped(*Filepath));
+	if (MappedHandle.IsValid() && MappedHandle->GetFileSize() > 0)
 	{
-		return;
+		MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+		if (MappedRegion.IsValid())
+		{
+			FileData = MappedRegion->GetMappedPtr();
+			FileSize = MappedRegion->GetMappedSize();
+			return true;
+		}
 	}
+	MappedHandle.Reset();
 
-	while (!Ar.eof())
+	// not every platform file supports mapping, fall back to reading the whole file in one go
+	if (!FFileHelper::LoadFileToArray(FileBuffer, *Filepath))
 	{
-		FPskHeader Header(Ar);
-		const auto Name = Header.ChunkName;
-		const auto Count = Header.Count;
-		const auto Size = Header.Count;
+		UE_LOG(LogUnrealPSKPSA, Error, TEXT("Failed to open %s"), *Filepath);
+		return false;
+	}
+
+	FileData = FileBuffer.GetData();
+	FileSize = FileBuffer.Num();
+	return true;
+}
+
+bool FPskMappedFile::ReadChunkDirectory(const ANSICHAR* MainChunkName, TArray<FPskChunk>& OutChunks) const
+{
+	ActorX::ChunkCursor Cursor(FileData, FileSize);
+	if (Cursor.ReadMainHeader(MainChunkName) != ActorX::ParseResult::Ok)
+	{
+		return false;
+	}
 
-		UE_LOG(LogUnrealPSKPSA, Log, TEXT("%s: %d"), *Name, Count);
+	ActorX::ChunkEntry Entry;
+	for (auto Result = Cursor.Next(Entry); Result != ActorX::ParseResult::End; Result = Cursor.Next(Entry))
+	{
+		const FPskChunk Chunk { FPskHeader(Entry.Header), Entry.Data };
+		const auto& Header = Chunk.Header;
+
+		UE_LOG(LogUnrealPSKPSA, Verbose, TEXT("%s: %d"), ANSI_TO_TCHAR(Header.ChunkName), Header.Count);
+
+		if (Result != ActorX::ParseResult::Ok)
+		{
+			UE_LOG(LogUnrealPSKPSA, Error, TEXT("%s: chunk runs past the end of the file"), ANSI_TO_TCHAR(Header.ChunkName));
+			OutChunks.Empty();
+			return false;
+		}
 		
-		if (Name.Equals("PNTS0000"))
+		OutChunks.Add(Chunk);
+	}
+
+	return true;
+}
+
+FPskReader::FPskReader(const FString& Filepath)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskReader::Open);
+	
+	if (!File.Open(Filepath) || !File.ReadChunkDirectory("ACTRHEAD", Chunks))
+	{
+		return;
+	}
+
+	const auto& Decoders = GetChunkDecoders();
+	for (auto& Chunk : Chunks)
+	{
+		if (const auto Decoder = Decoders.Find(Chunk.Header.ChunkHash))
 		{
-			Vertices.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
-			{
-				Ar.read(reinterpret_cast<char*>(&Vertices[i]), sizeof(FVector3f));
-			}
+			Chunk.Type = Decoder->Type;
 		}
-		else if (Name.Equals("VTXW0000"))
+	}
+
+	bIsValid = true;
+}
+
+static bool CheckElementSize(const FPskHeader& Header, const int32 ExpectedSize)
+{
+	if (Header.Size != ExpectedSize)
+	{
+		UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s: expected element size %d but got %d, skipping"), ANSI_TO_TCHAR(Header.ChunkName), ExpectedSize, Header.Size);
+		return false;
+	}
+	return true;
+}
+
+// per point and per wedge chunks that are too short would be read past their end, they are dropped instead
+static bool CheckElementCount(const FPskHeader& Header, const int32 ExpectedCount, const TCHAR* ElementName)
+{
+	if (Header.Count != ExpectedCount)
+	{
+		UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s: expected one element per %s (%d) but got %d, skipping"), ANSI_TO_TCHAR(Header.ChunkName), ElementName, ExpectedCount, Header.Count);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Copies a chunk into Storage as one block and then unpacks it back to front, so every packed element is read
+ * before the wider unpacked elements in front of it get written over it.
+ */
+template <typename T, int32 PackedSize, typename FuncType>
+static TConstArrayView<T> WidenChunk(const FPskChunk& Chunk, TArray<T>& Storage, FuncType&& Unpack)
+{
+	static_assert(PackedSize <= sizeof(T), "Packed elements must not be larger than the unpacked struct");
+	
+	if (!CheckElementSize(Chunk.Header, PackedSize))
+	{
+		return TConstArrayView<T>();
+	}
+
+	const auto Count = Chunk.Header.Count;
+	Storage.SetNumUninitialized(Count);
+	
+	auto Bytes = reinterpret_cast<uint8*>(Storage.GetData());
+	FMemory::Memcpy(Bytes, Chunk.Data, Chunk.Header.GetDataSize());
+	
+	for (auto i = Count - 1; i >= 0; i--)
+	{
+		uint8 Packed[PackedSize];
+		FMemory::Memcpy(Packed, Bytes + static_cast<int64>(i) * PackedSize, PackedSize);
+		Unpack(Packed, Storage[i]);
+	}
+	
+	return Storage;
+}
+
+template <typename T>
+TConstArrayView<T> FPskReader::ViewChunk(const FPskChunk& Chunk, TArray<T>& FallbackStorage)
+{
+	if (!CheckElementSize(Chunk.Header, sizeof(T)))
+	{
+		return TConstArrayView<T>();
+	}
+
+	if (IsAligned(Chunk.Data, alignof(T)))
+	{
+		return MakeArrayView(reinterpret_cast<const T*>(Chunk.Data), Chunk.Header.Count);
+	}
+
+	// an odd sized chunk before this one left it misaligned, copy it out instead of reading it in place
+	FallbackStorage.SetNumUninitialized(Chunk.Header.Count);
+	FMemory::Memcpy(FallbackStorage.GetData(), Chunk.Data, Chunk.Header.GetDataSize());
+	return FallbackStorage;
+}
+
+const TMap<uint32, FPskReader::FChunkDecoder>& FPskReader::GetChunkDecoders()
+{
+	static const TMap<uint32, FChunkDecoder> Decoders =
+	{
 		{
-			Wedges.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("PNTS0000"), { EPskChunk::Points, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&Wedges[i]), sizeof(VVertex));
-				if (Count <= 65536)
-				{
-					Wedges[i].PointIndex &= 0xFFFF;
-				}
-			}
-		}
-		else if (Name.Equals("FACE0000"))
+				Reader.Vertices = ViewChunk(Chunk, Reader.VerticesStorage);
+			} }
+		},
 		{
-			Faces.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("VTXW0000"), { EPskChunk::Wedges, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				for (auto j = 0; j < 3; j++)
+				Reader.Wedges = ViewChunk(Chunk, Reader.WedgesStorage);
+				if (!ActorX::HasShortPointIndices(Chunk.Header.Count) || Reader.Wedges.IsEmpty()) return;
+				
+				// small meshes store a 16 bit point index followed by padding
+				if (Reader.Wedges.GetData() != Reader.WedgesStorage.GetData())
 				{
-					Ar.read(reinterpret_cast<char*>(&Faces[i].WedgeIndex[j]), sizeof(short));
-					Faces[i].WedgeIndex[j] &= 0xFFFF;
+					Reader.WedgesStorage = TArray<VVertex>(Reader.Wedges);
 				}
-	                
-				Ar.read(&Faces[i].MatIndex, sizeof(char));
-				Ar.read(&Faces[i].AuxMatIndex, sizeof(char));
-				Ar.read(reinterpret_cast<char*>(&Faces[i].SmoothingGroups), sizeof(unsigned));
-			}
-		}
-		else if (Name.Equals("FACE3200"))
+				
+				for (auto& Wedge : Reader.WedgesStorage)
+				{
+					Wedge.PointIndex &= 0xFFFF;
+				}
+				Reader.Wedges = Reader.WedgesStorage;
+			} }
+		},
 		{
-			Faces.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("FACE0000"), { EPskChunk::Faces, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&Faces[i].WedgeIndex), sizeof Faces[i].WedgeIndex);
-				Ar.read(&Faces[i].MatIndex, sizeof(char));
-                Ar.read(&Faces[i].AuxMatIndex, sizeof(char));
-                Ar.read(reinterpret_cast<char*>(&Faces[i].SmoothingGroups), sizeof(unsigned));
-			}
-		}
-		else if (Name.Equals("MATT0000"))
+				Reader.Faces = WidenChunk<VTriangle, PackedFace16Size>(Chunk, Reader.FacesStorage, &ActorX::UnpackFace16<VTriangle>);
+			} }
+		},
 		{
-			Materials.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("FACE3200"), { EPskChunk::Faces, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&Materials[i]), sizeof(VMaterial));
-			}
-		}
-		else if (Name.Equals("VTXNORMS"))
+				Reader.Faces = WidenChunk<VTriangle, PackedFace32Size>(Chunk, Reader.FacesStorage, &ActorX::UnpackFace32<VTriangle>);
+			} }
+		},
 		{
-			Normals.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("MATT0000"), { EPskChunk::Materials, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&Normals[i]), sizeof(FVector3f));
-			}
-		}
-		else if (Name.Equals("VERTEXCOLOR"))
+				Reader.Materials = ViewChunk(Chunk, Reader.MaterialsStorage);
+			} }
+		},
 		{
-			VertexColors.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("VTXNORMS"), { EPskChunk::Normals, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&VertexColors[i]), sizeof(FColor));
-			}
-		}
-		else if (Name.Equals("EXTRAUVS"))
+				Reader.Normals = CheckElementCount(Chunk.Header, Reader.GetCount(EPskChunk::Points), TEXT("point"))
+					? ViewChunk(Chunk, Reader.NormalsStorage)
+					: TConstArrayView<FVector3f>();
+			} }
+		},
 		{
-			TArray<FVector2f> UVData;
-			UVData.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("VTXTANGS"), { EPskChunk::Tangents, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&UVData[i]), sizeof(FVector2f));
-			}
-
-			ExtraUVs.Add(UVData);
-		}
-		else if (Name.Equals("REFSKELT") || Name.Equals("REFSKEL0"))
+				Reader.Tangents = CheckElementCount(Chunk.Header, Reader.GetCount(EPskChunk::Wedges), TEXT("wedge"))
+					? ViewChunk(Chunk, Reader.TangentsStorage)
+					: TConstArrayView<FVector4f>();
+			} }
+		},
 		{
-			Bones.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("VERTEXCOLOR"), { EPskChunk::VertexColors, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&Bones[i].Name), sizeof(Bones[i].Name));
-				Ar.read(reinterpret_cast<char*>(&Bones[i].Flags), sizeof(int));
-				Ar.read(reinterpret_cast<char*>(&Bones[i].NumChildren), sizeof(int));
-				Ar.read(reinterpret_cast<char*>(&Bones[i].ParentIndex), sizeof(int));
-				Ar.read(reinterpret_cast<char*>(&Bones[i].BonePos.Orientation), sizeof(FQuat4f));
-				Ar.read(reinterpret_cast<char*>(&Bones[i].BonePos.Position), sizeof(FVector3f));
-				
-				Ar.read(reinterpret_cast<char*>(&Bones[i].BonePos.Length), sizeof(float));
-				Ar.read(reinterpret_cast<char*>(&Bones[i].BonePos.XSize), sizeof(float));
-				Ar.read(reinterpret_cast<char*>(&Bones[i].BonePos.YSize), sizeof(float));
-				Ar.read(reinterpret_cast<char*>(&Bones[i].BonePos.ZSize), sizeof(float));
-	            	
-			}
-		}
-		else if (Name.Equals("RAWWEIGHTS") || Name.Equals("RAWW0000"))
+				Reader.VertexColors = CheckElementCount(Chunk.Header, Reader.GetCount(EPskChunk::Wedges), TEXT("wedge"))
+					? ViewChunk(Chunk, Reader.VertexColorsStorage)
+					: TConstArrayView<FColor>();
+			} }
+		},
 		{
-			Influences.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("EXTRAUVS"), { EPskChunk::ExtraUVs, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&Influences[i]), sizeof(VRawBoneInfluence));
-			}
-		}
-		else if (Name.Equals("MRPHINFO"))
+				if (!CheckElementCount(Chunk.Header, Reader.GetCount(EPskChunk::Wedges), TEXT("wedge"))) return;
+				
+				// a channel that fails to decode is left out, the channels after it move up
+				const auto UVs = ViewChunk(Chunk, Reader.ExtraUVsStorage.AddDefaulted_GetRef());
+				if (!UVs.IsEmpty())
+				{
+					Reader.ExtraUVs.Add(UVs);
+				}
+			} }
+		},
 		{
-			MorphInfos.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
-			{
-				Ar.read(reinterpret_cast<char*>(&MorphInfos[i]), sizeof(VMorphInfo));
-			}
-		}
-		else if (Name.Equals("MRPHDATA"))
+			PskChunkHash("REFSKELT"), { EPskChunk::Bones, &DecodeBones }
+		},
+		{
+			PskChunkHash("REFSKEL0"), { EPskChunk::Bones, &DecodeBones }
+		},
+		{
+			PskChunkHash("RAWWEIGHTS"), { EPskChunk::Influences, &DecodeInfluences }
+		},
+		{
+			PskChunkHash("RAWW0000"), { EPskChunk::Influences, &DecodeInfluences }
+		},
 		{
-			MorphDatas.SetNum(Count);
-			for (auto i = 0; i < Count; i++)
+			PskChunkHash("MRPHINFO"), { EPskChunk::MorphInfos, [](FPskReader& Reader, const FPskChunk& Chunk)
 			{
-				Ar.read(reinterpret_cast<char*>(&MorphDatas[i]), sizeof(VMorphData));
-			}
-		}
-		else
+				Reader.MorphInfos = ViewChunk(Chunk, Reader.MorphInfosStorage);
+			} }
+		},
 		{
-			Ar.ignore(Size*Count); 
-		}
-	}
+			PskChunkHash("MRPHDATA"), { EPskChunk::MorphDatas, [](FPskReader& Reader, const FPskChunk& Chunk)
+			{
+				Reader.MorphDatas = ViewChunk(Chunk, Reader.MorphDatasStorage);
+			} }
+		},
+	};
+	
+	return Decoders;
+}
 
-	Ar.close();
+void FPskReader::DecodeBones(FPskReader& Reader, const FPskChunk& Chunk)
+{
+	Reader.Bones = UnpackBones(Chunk, Reader.BonesStorage);
+}
 
-	bIsValid = true;
-	bHasVertexNormals = Normals.Num() > 0;
-	bHasVertexColors = VertexColors.Num() > 0;
-	bHasMorphData = MorphInfos.Num() > 0 && MorphDatas.Num() > 0;
+TConstArrayView<VNamedBoneBinary> FPskReader::UnpackBones(const FPskChunk& Chunk, TArray<VNamedBoneBinary>& Storage)
+{
+	return WidenChunk<VNamedBoneBinary, PackedBoneSize>(Chunk, Storage, &ActorX::UnpackBone<VNamedBoneBinary>);
 }
 
+void FPskReader::DecodeInfluences(FPskReader& Reader, const FPskChunk& Chunk)
+{
+	Reader.Influences = ViewChunk(Chunk, Reader.InfluencesStorage);
+}
+
+void FPskReader::LoadChunks(const EPskChunk Type)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FPskReader::LoadChunks);
+	
+	FScopeLock Lock(&LoadLock);
+	
+	const auto& Decoders = GetChunkDecoders();
+	for (auto& Chunk : Chunks)
+	{
+		if (Chunk.Type != Type || Chunk.bLoaded) continue;
+		
+		Decoders[Chunk.Header.ChunkHash].Decode(*this, Chunk);
+		Chunk.bLoaded = true;
+	}
+}
+
+const FPskChunk* FPskReader::FindChunk(const EPskChunk Type) const
+{
+	return Chunks.FindByPredicate([Type](const FPskChunk& Chunk) { return Chunk.Type == Type; });
+}
+
+int32 FPskReader::GetCount(const EPskChunk Type) const
+{
+	// the last chunk of a type wins when decoding, except for extra uvs which are one chunk per channel
+	auto Count = 0;
+	for (const auto& Chunk : Chunks)
+	{
+		if (Chunk.Type != Type) continue;
+		Count = Type == EPskChunk::ExtraUVs ? Count + 1 : Chunk.Header.Count;
+	}
+	return Count;
+}
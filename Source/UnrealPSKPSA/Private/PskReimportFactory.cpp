@@ -0,0 +1,144 @@
+﻿#include "PskReimportFactory.h"
+
+#include "PskAssetImportData.h"
+#include "PskFactory.h"
+#include "PskMaterialResolver.h"
+#include "PskPsaUtils.h"
+#include "PskReader.h"
+#include "PskxFactory.h"
+#include "UnrealPSKPSA.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+
+// the factories place assets, skeletons and materials next to their parent, for a reimport that is the asset's folder
+static UObject* GetFolderParent(const UObject* Mesh)
+{
+	return CreatePackage(*FPackageName::GetLongPackagePath(Mesh->GetOutermost()->GetName()));
+}
+
+// false if the material slots no longer line up with the file, which needs a full reimport
+static bool UpdateMaterials(UObject* Mesh, UPskAssetImportData* ImportData, const TConstArrayView<VMaterial> PskMaterials)
+{
+	TArray<FString> MaterialNames;
+	for (const auto& PskMaterial : PskMaterials)
+	{
+		MaterialNames.Add(PskMaterial.MaterialName);
+	}
+	
+	const auto Flags = Mesh->GetMaskedFlags(RF_Public | RF_Standalone | RF_Transactional);
+	// materials found through a material map at import time are looked up there again, new ones land next to the mesh
+	FPskMaterialResolver MaterialResolver(ImportData->MaterialNameToPathMap);
+	
+	if (const auto SkeletalMesh = Cast<USkeletalMesh>(Mesh))
+	{
+		auto& SkeletalMaterials = SkeletalMesh->GetMaterials();
+		if (SkeletalMaterials.Num() != MaterialNames.Num()) return false;
+
+		const auto Materials = MaterialResolver.Resolve(MaterialNames, GetFolderParent(Mesh), Flags);
+		SkeletalMesh->PreEditChange(nullptr);
+		for (auto i = 0; i < Materials.Num(); i++)
+		{
+			SkeletalMaterials[i].MaterialInterface = Materials[i];
+		}
+		SkeletalMesh->PostEditChange();
+		ImportData->SetMaterials(MaterialNames, Materials);
+		return true;
+	}
+	
+	if (const auto StaticMesh = Cast<UStaticMesh>(Mesh))
+	{
+		auto& StaticMaterials = StaticMesh->GetStaticMaterials();
+		if (StaticMaterials.Num() != MaterialNames.Num()) return false;
+
+		const auto Materials = MaterialResolver.Resolve(MaterialNames, GetFolderParent(Mesh), Flags);
+		StaticMesh->PreEditChange(nullptr);
+		for (auto i = 0; i < Materials.Num(); i++)
+		{
+			StaticMaterials[i].MaterialInterface = Materials[i];
+			StaticMaterials[i].MaterialSlotName = FName(MaterialNames[i]);
+			StaticMaterials[i].ImportedMaterialSlotName = StaticMaterials[i].MaterialSlotName;
+		}
+		StaticMesh->PostEditChange();
+		ImportData->SetMaterials(MaterialNames, Materials);
+		return true;
+	}
+	
+	return false;
+}
+
+bool UPskReimportFactory::CanReimport(UObject* Obj, TArray<FString>& OutFilenames)
+{
+	const auto ImportData = UPskAssetImportData::Get(Obj);
+	if (ImportData == nullptr) return false;
+
+	ImportData->ExtractFilenames(OutFilenames);
+	return true;
+}
+
+void UPskReimportFactory::SetReimportPaths(UObject* Obj, const TArray<FString>& NewReimportPaths)
+{
+	const auto ImportData = UPskAssetImportData::Get(Obj);
+	if (ImportData == nullptr || NewReimportPaths.Num() != 1) return;
+
+	ImportData->UpdateFilenameOnly(NewReimportPaths[0]);
+}
+
+EReimportResult::Type UPskReimportFactory::Reimport(UObject* Obj)
+{
+	const auto ImportData = UPskAssetImportData::Get(Obj);
+	if (ImportData == nullptr) return EReimportResult::Failed;
+
+	const auto Filename = ImportData->GetFirstFilename();
+	if (Filename.IsEmpty() || !FPaths::FileExists(Filename))
+	{
+		UE_LOG(LogUnrealPSKPSA, Warning, TEXT("Cannot reimport %s, source file %s does not exist"), *Obj->GetName(), *Filename);
+		return EReimportResult::Failed;
+	}
+
+	{
+		FPskReader Reader(Filename);
+		if (!Reader.bIsValid) return EReimportResult::Failed;
+
+		// sibling LOD files are hashed as well, the file may have gained or lost LODs since it was imported
+		auto ChunkHashes = UPskAssetImportData::HashChunks(Reader.GetChunks());
+		const auto LODFilenames = FPskPsaUtils::FindLODFilenames(Filename);
+		for (auto LODIndex = 1; LODIndex < LODFilenames.Num(); LODIndex++)
+		{
+			const FPskReader LODReader(LODFilenames[LODIndex]);
+			if (!LODReader.bIsValid) break;
+			
+			UPskAssetImportData::AppendLODChunkHashes(ChunkHashes, UPskAssetImportData::HashChunks(LODReader.GetChunks()), LODIndex);
+		}
+		
+		switch (ImportData->Compare(ChunkHashes))
+		{
+		case EPskReimportChange::None:
+			UE_LOG(LogUnrealPSKPSA, Log, TEXT("%s is unchanged, skipping reimport of %s"), *Filename, *Obj->GetName());
+			return EReimportResult::Succeeded;
+			
+		case EPskReimportChange::MaterialsOnly:
+			if (UpdateMaterials(Obj, ImportData, Reader.GetMaterials()))
+			{
+				UE_LOG(LogUnrealPSKPSA, Log, TEXT("Only materials of %s changed, updated materials of %s"), *Filename, *Obj->GetName());
+				ImportData->ChunkHashes = ChunkHashes;
+				Obj->MarkPackageDirty();
+				return EReimportResult::Succeeded;
+			}
+			break;
+			
+		case EPskReimportChange::Full:
+			break;
+		}
+	}
+
+	// the factories rebuild the mesh in place, everything not read from the file stays as the user left it
+	const auto Parent = GetFolderParent(Obj);
+	const auto Flags = Obj->GetMaskedFlags(RF_Public | RF_Standalone | RF_Transactional);
+	const auto MaterialNameToPathMap = ImportData->MaterialNameToPathMap;
+	
+	const auto Mesh = Obj->IsA<UStaticMesh>()
+		? UPskxFactory::Import(Filename, Parent, Obj->GetFName(), Flags, MaterialNameToPathMap, Cast<UStaticMesh>(Obj))
+		: UPskFactory::Import(Filename, Parent, Obj->GetFName(), Flags, MaterialNameToPathMap, Cast<USkeletalMesh>(Obj));
+	
+	return Mesh != nullptr ? EReimportResult::Succeeded : EReimportResult::Failed;
+}
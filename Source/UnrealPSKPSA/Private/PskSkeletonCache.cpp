@@ -0,0 +1,159 @@
+﻿#include "PskSkeletonCache.h"
+
+#include "PskPsaUtils.h"
+#include "UnrealPSKPSA.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Misc/PackageName.h"
+#include "Rendering/SkeletalMeshLODImporterData.h"
+
+// rigs sharing only a root or a handful of bones are unrelated, at least this share of the imported bones must match
+constexpr float MinSharedBoneRatio = 0.9f;
+// folders searched for skeletons of earlier sessions, the import folder and the ones right above it
+constexpr int32 MaxSearchDepth = 3;
+
+TMap<uint32, TWeakObjectPtr<USkeleton>> FPskSkeletonCache::SkeletonsByHash;
+
+USkeleton* FPskSkeletonCache::FindOrCreate(const FSkeletalMeshImportData& ImportData, UObject* Parent, const FString& SkeletonName, const EObjectFlags Flags, bool& bOutCreated)
+{
+	check(IsInGameThread());
+	
+	bOutCreated = false;
+	
+	const auto Hash = HashHierarchy(ImportData);
+	if (const auto Found = SkeletonsByHash.Find(Hash))
+	{
+		if (const auto Skeleton = Found->Get())
+		{
+			return Skeleton;
+		}
+	}
+
+	// the import folder and the ones just above it, where skeletons of earlier sessions usually are
+	TArray<FString> Folders;
+	for (auto Folder = FPaths::GetPath(Parent->GetPathName() + "/"); Folders.Num() < MaxSearchDepth && !Folder.IsEmpty(); Folder = FPaths::GetPath(Folder))
+	{
+		Folders.Add(Folder);
+	}
+
+	TSet<USkeleton*> Candidates;
+	for (const auto& [OtherHash, WeakSkeleton] : SkeletonsByHash)
+	{
+		if (const auto Skeleton = WeakSkeleton.Get())
+		{
+			Candidates.Add(Skeleton);
+		}
+	}
+	{
+		const auto& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+		
+		FARFilter Filter;
+		Filter.ClassPaths.Add(USkeleton::StaticClass()->GetClassPathName());
+		Filter.bRecursiveClasses = true;
+		Filter.bRecursivePaths = false;
+		for (const auto& Folder : Folders)
+		{
+			Filter.PackagePaths.Add(FName(Folder));
+		}
+		
+		TArray<FAssetData> Assets;
+		AssetRegistry.GetAssets(Filter, Assets);
+		for (const auto& Asset : Assets)
+		{
+			if (const auto Skeleton = Cast<USkeleton>(Asset.GetAsset()))
+			{
+				Candidates.Add(Skeleton);
+			}
+		}
+	}
+
+	// nearest folder first, then the larger overlap, then the path so the choice does not depend on iteration order
+	USkeleton* BestSkeleton = nullptr;
+	auto BestDistance = 0;
+	auto BestRatio = 0.0f;
+	for (const auto Skeleton : Candidates)
+	{
+		const auto Ratio = GetSharedBoneRatio(ImportData, Skeleton);
+		if (Ratio < MinSharedBoneRatio) continue;
+
+		const auto Distance = Folders.IndexOfByKey(FPackageName::GetLongPackagePath(Skeleton->GetOutermost()->GetName()));
+		const auto FolderDistance = Distance != INDEX_NONE ? Distance : Folders.Num();
+		const auto bIsBetter = BestSkeleton == nullptr
+			|| FolderDistance < BestDistance
+			|| (FolderDistance == BestDistance && (Ratio > BestRatio || (Ratio == BestRatio && Skeleton->GetPathName() < BestSkeleton->GetPathName())));
+		if (bIsBetter)
+		{
+			BestSkeleton = Skeleton;
+			BestDistance = FolderDistance;
+			BestRatio = Ratio;
+		}
+	}
+
+	if (BestSkeleton != nullptr)
+	{
+		UE_LOG(LogUnrealPSKPSA, Log, TEXT("Merging %s into compatible skeleton %s (%.0f%% of its bones shared)"), *SkeletonName, *BestSkeleton->GetPathName(), BestRatio * 100.0f);
+		return BestSkeleton;
+	}
+
+	bOutCreated = true;
+	return FPskPsaUtils::LocalCreate<USkeleton>(USkeleton::StaticClass(), Parent, SkeletonName, Flags);
+}
+
+void FPskSkeletonCache::Add(const FSkeletalMeshImportData& ImportData, USkeleton* Skeleton)
+{
+	SkeletonsByHash.Add(HashHierarchy(ImportData), Skeleton);
+}
+
+uint32 FPskSkeletonCache::HashHierarchy(const FSkeletalMeshImportData& ImportData)
+{
+	auto Hash = GetTypeHash(ImportData.RefBonesBinary.Num());
+	for (const auto& Bone : ImportData.RefBonesBinary)
+	{
+		const auto& Transform = Bone.BonePos.Transform;
+		const FVector3f Location = Transform.GetLocation();
+		const FQuat4f Rotation = Transform.GetRotation();
+		
+		Hash = HashCombine(Hash, GetTypeHash(Bone.Name));
+		Hash = HashCombine(Hash, GetTypeHash(Bone.ParentIndex));
+		Hash = FCrc::MemCrc32(&Location, sizeof Location, Hash);
+		Hash = FCrc::MemCrc32(&Rotation, 4 * sizeof(float), Hash);
+	}
+	return Hash;
+}
+
+float FPskSkeletonCache::GetSharedBoneRatio(const FSkeletalMeshImportData& ImportData, const USkeleton* Skeleton)
+{
+	const auto& Bones = ImportData.RefBonesBinary;
+	const auto& RefSkeleton = Skeleton->GetReferenceSkeleton();
+	if (Bones.Num() == 0 || RefSkeleton.GetNum() == 0 || RefSkeleton.GetBoneName(0) != FName(*Bones[0].Name))
+	{
+		return 0.0f;
+	}
+
+	// every bone the skeleton already has must hang off the same parent, missing bones get merged in
+	auto NumShared = 1;
+	for (auto BoneIndex = 1; BoneIndex < Bones.Num(); BoneIndex++)
+	{
+		const auto SkeletonBoneIndex = RefSkeleton.FindBoneIndex(FName(*Bones[BoneIndex].Name));
+		if (SkeletonBoneIndex == INDEX_NONE) continue;
+
+		const auto ParentIndex = Bones[BoneIndex].ParentIndex;
+		const auto SkeletonParentIndex = RefSkeleton.GetParentIndex(SkeletonBoneIndex);
+		if (ParentIndex == INDEX_NONE || SkeletonParentIndex == INDEX_NONE)
+		{
+			return 0.0f;
+		}
+		
+		if (RefSkeleton.GetBoneName(SkeletonParentIndex) != FName(*Bones[ParentIndex].Name))
+		{
+			return 0.0f;
+		}
+		NumShared++;
+	}
+	
+	return static_cast<float>(NumShared) / Bones.Num();
+}
+
+bool FPskSkeletonCache::IsCompatible(const FSkeletalMeshImportData& ImportData, const USkeleton* Skeleton)
+{
+	return GetSharedBoneRatio(ImportData, Skeleton) >= MinSharedBoneRatio;
+}
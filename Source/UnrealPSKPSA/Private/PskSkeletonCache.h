@@ -0,0 +1,27 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+
+struct FSkeletalMeshImportData;
+class USkeleton;
+
+/*
+ * Skeletons used during this editor session, keyed by a hash of the bone hierarchy they were used for. Meshes sharing
+ * a rig reuse the same USkeleton instead of each getting their own. On a miss, skeletons of this session and skeleton
+ * assets in and just above the import folder are considered, a mesh is merged into one that shares most of its bones
+ * under the same parents. Skeletons closer to the import folder win, so a new session finds the one it created before.
+ */
+class FPskSkeletonCache
+{
+public:
+	// game thread only, bOutCreated is set when no cached skeleton could be reused
+	static USkeleton* FindOrCreate(const FSkeletalMeshImportData& ImportData, UObject* Parent, const FString& SkeletonName, const EObjectFlags Flags, bool& bOutCreated);
+	static void Add(const FSkeletalMeshImportData& ImportData, USkeleton* Skeleton);
+	
+	static uint32 HashHierarchy(const FSkeletalMeshImportData& ImportData);
+	// share of the imported bones the skeleton has under the same parent, 0 if any shared bone has another parent
+	static float GetSharedBoneRatio(const FSkeletalMeshImportData& ImportData, const USkeleton* Skeleton);
+	static bool IsCompatible(const FSkeletalMeshImportData& ImportData, const USkeleton* Skeleton);
+
+private:
+	static TMap<uint32, TWeakObjectPtr<USkeleton>> SkeletonsByHash;
+};
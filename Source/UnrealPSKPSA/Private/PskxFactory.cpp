@@ -1,100 +1,248 @@
 ﻿#include "PskxFactory.h"
 
+#include "PskAssetImportData.h"
+#include "PskAsyncImport.h"
+#include "PskImportData.h"
+#include "PskImportDataCache.h"
+#include "PskImportTransaction.h"
+#include "PskMaterialResolver.h"
+#include "PskMeshConverter.h"
 #include "PskPsaUtils.h"
 #include "PskReader.h"
-#include "RawMesh.h"
-#include "Materials/MaterialInstanceConstant.h"
+#include "UnrealPSKPSA.h"
+#include "Hash/CityHash.h"
 
-UObject* UPskxFactory::Import(const FString& Filename, UObject* Parent, const FName Name, const EObjectFlags Flags, TMap<FString, FString> MaterialNameToPathMap)
+UObject* UPskxFactory::Import(const FString& Filename, UObject* Parent, const FName Name, const EObjectFlags Flags, TMap<FString, FString> MaterialNameToPathMap, UStaticMesh* ExistingMesh)
 {
-	auto Data = FPskReader(Filename);
-	if (!Data.bIsValid) return nullptr;
+	TArray<FPskxMeshImportData> LODs;
+	if (!ReadMeshLODs(Filename, LODs))
+	{
+		FinishReports(LODs, nullptr);
+		return nullptr;
+	}
+
+	FPskMaterialResolver MaterialResolver(MaterialNameToPathMap);
+	const auto StaticMesh = CreateMesh(LODs, Parent, Name, Flags, MaterialResolver, ExistingMesh);
+	FinishReports(LODs, StaticMesh);
+	return StaticMesh;
+}
+
+UObject* UPskxFactory::FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Params, FFeedbackContext* Warn, bool& bOutOperationCanceled)
+{
+	const auto Name = FName(*InName.ToString().Replace(TEXT("_LOD0"), TEXT("")));
+	
+	// read, convert and create
+	FScopedSlowTask SlowTask(3, FText::Format(NSLOCTEXT("UnrealPSKPSA", "ImportingFile", "Importing {0}"), FText::FromName(Name)), true, Warn != nullptr ? *Warn : *GWarn);
+	SlowTask.MakeDialog(true);
+	
+	TArray<FPskxMeshImportData> LODs;
+	if (!FPskAsyncImport::ReadMesh(SlowTask, Filename, LODs, &ReadMeshLODs, bOutOperationCanceled))
+	{
+		FinishReports(LODs, nullptr);
+		return nullptr;
+	}
+
+	SlowTask.EnterProgressFrame(1, FText::Format(NSLOCTEXT("UnrealPSKPSA", "CreatingAsset", "Creating {0}"), FText::FromName(Name)));
+	FPskMaterialResolver MaterialResolver((TMap<FString, FString>()));
+	const auto StaticMesh = CreateMesh(LODs, InParent, Name, Flags, MaterialResolver);
+	FinishReports(LODs, StaticMesh);
+	return StaticMesh;
+}
+
+bool UPskxFactory::ReadMeshLODs(const FString& Filename, TArray<FPskxMeshImportData>& OutLODs, FPskImportProgress* Progress)
+{
+	return FPskAsyncImport::ReadLODs(Filename, OutLODs, Progress, &ReadMesh);
+}
+
+void UPskxFactory::FinishReports(TArrayView<FPskxMeshImportData> LODs, const UObject* Asset)
+{
+	for (auto& LOD : LODs)
+	{
+		LOD.Report.Finish(Asset);
+	}
+}
+
+bool UPskxFactory::ReadMesh(const FString& Filename, FPskxMeshImportData& OutMeshData, FPskImportProgress* Progress)
+{
+	auto& Report = OutMeshData.Report;
+	Report.Filename = Filename;
+	Report.Memory.Begin();
 	
-	TArray<FColor> VertexColorsByPoint;
-	VertexColorsByPoint.Init(FColor::Black, Data.VertexColors.Num());
-	if (Data.bHasVertexColors)
+	TUniquePtr<FPskReader> Reader;
+	const auto TangentMethod = FPskMeshConverter::GetTangentMethod();
+	uint64 CacheHash;
 	{
-		for (auto i = 0; i < Data.Wedges.Num(); i++)
+		PSK_IMPORT_STAGE(STAT_PskImport_Read, Report.Timings.Read);
+		
+		Reader = MakeUnique<FPskReader>(Filename);
+		if (!Reader->bIsValid) return false;
+
+		Report.Counters.BytesRead = Reader->GetFileSize();
+		Report.Counters.Points = Reader->GetCount(EPskChunk::Points);
+		Report.Counters.Wedges = Reader->GetCount(EPskChunk::Wedges);
+		Report.Counters.Faces = Reader->GetCount(EPskChunk::Faces);
+		Report.Counters.Materials = Reader->GetCount(EPskChunk::Materials);
+
+		OutMeshData.ChunkHashes = UPskAssetImportData::HashChunks(Reader->GetChunks());
+		// converted data depends on the tangent method as well as on the file
+		CacheHash = CityHash128to64(Uint128_64(UPskAssetImportData::GetContentHash(OutMeshData.ChunkHashes), static_cast<uint64>(TangentMethod)));
+		if (FPskImportDataCache::Get(CacheHash, OutMeshData))
 		{
-			auto FixedColor = Data.VertexColors[i];
-			Swap(FixedColor.R, FixedColor.B);
-			VertexColorsByPoint[Data.Wedges[i].PointIndex] = FixedColor;
+			Report.bFromCache = true;
+			Report.Memory.ImportDataBytes = OutMeshData.GetAllocatedSize();
+			return true;
 		}
+
+		// decode every chunk the conversion needs up front so reading and converting are timed separately
+		Reader->GetVertices();
+		Reader->GetWedges();
+		Reader->GetFaces();
+		Reader->GetNormals();
+		Reader->GetTangents();
+		Reader->GetVertexColors();
+		Reader->GetExtraUVs();
+		Reader->GetMaterials();
 	}
 
-	// TODO STATIC MESH DESCRIPTION
-	auto RawMesh = FRawMesh();
-	for (auto Vertex : Data.Vertices)
+	if (Progress != nullptr && !Progress->EnterStage(EPskImportStage::Convert)) return false;
+
+	PSK_IMPORT_STAGE(STAT_PskImport_Convert, Report.Timings.Convert);
+
+	auto& Data = *Reader;
+	const auto Materials = Data.GetMaterials();
+
+	for (auto PskMaterial : Materials)
 	{
-		auto FixedVertex = Vertex;
-		FixedVertex.Y = -FixedVertex.Y; // MIRROR_MESH
-		RawMesh.VertexPositions.Add(FixedVertex);
+		OutMeshData.MaterialNames.Add(PskMaterial.MaterialName);
 	}
 
-	auto WindingOrder = {2, 1, 0};
-	for (const auto PskFace : Data.Faces)
+	OutMeshData.bHasVertexNormals = Data.HasVertexNormals();
+
 	{
-		RawMesh.FaceMaterialIndices.Add(PskFace.MatIndex);
-		RawMesh.FaceSmoothingMasks.Add(1);
+		FPskMeshBuffers Buffers;
+		if (!FPskMeshConverter::Convert(Data, Buffers, false))
+		{
+			UE_LOG(LogUnrealPSKPSA, Warning, TEXT("%s has wedges or faces referencing points or wedges it does not contain, skipping it"), *Filename);
+			return false;
+		}
+		Report.Memory.Sample();
+		Reader.Reset();
 
-		for (auto VertexIndex : WindingOrder)
+		if (TangentMethod == EPskTangentMethod::Fast)
 		{
-			const auto WedgeIndex = PskFace.WedgeIndex[VertexIndex];
-			const auto PskWedge = Data.Wedges[WedgeIndex];
+			FPskMeshConverter::FindOrGenerateTangents(Buffers, OutMeshData.ChunkHashes, Filename);
+		}
+		OutMeshData.bHasTangents = Buffers.bHasTangents;
+		
+		FPskMeshConverter::ToMeshDescription(Buffers, OutMeshData.MaterialNames, OutMeshData.MeshDescription);
+		Report.Memory.Sample();
+	}
+	Report.Memory.ImportDataBytes = OutMeshData.GetAllocatedSize();
+
+	// only the import data is alive at this point, storing it streams through one block at a time
+	FPskImportDataCache::Put(CacheHash, OutMeshData);
+	Report.Memory.Sample();
+	return true;
+}
+
+UObject* UPskxFactory::CreateMesh(FPskxMeshImportData& MeshData, UObject* Parent, const FName Name, const EObjectFlags Flags, FPskMaterialResolver& MaterialResolver)
+{
+	return CreateMesh(MakeArrayView(&MeshData, 1), Parent, Name, Flags, MaterialResolver);
+}
+
+UObject* UPskxFactory::CreateMesh(TArrayView<FPskxMeshImportData> LODs, UObject* Parent, const FName Name, const EObjectFlags Flags, FPskMaterialResolver& MaterialResolver, UStaticMesh* ExistingMesh)
+{
+	check(IsInGameThread());
+	check(LODs.Num() > 0);
+
+	// creating the mesh is accounted to the report of LOD0, lower LOD reports only carry their read stages
+	auto& MeshData = LODs[0];
+	auto& Timings = MeshData.Report.Timings;
+	PSK_IMPORT_STAGE(STAT_PskImport_Create, Timings.Create);
+	
+	// source models of an existing mesh are replaced, the settings of the LODs it keeps are carried over
+	TArray<FStaticMeshSourceModel> KeptSourceModels;
+	UStaticMesh* StaticMesh;
+	if (ExistingMesh != nullptr)
+	{
+		StaticMesh = ExistingMesh;
+		StaticMesh->PreEditChange(nullptr);
+		for (auto LODIndex = 0; LODIndex < FMath::Min(StaticMesh->GetNumSourceModels(), LODs.Num()); LODIndex++)
+		{
+			const auto& SourceModel = StaticMesh->GetSourceModel(LODIndex);
+			auto& KeptSourceModel = KeptSourceModels.AddDefaulted_GetRef();
+			KeptSourceModel.BuildSettings = SourceModel.BuildSettings;
+			KeptSourceModel.ReductionSettings = SourceModel.ReductionSettings;
+			KeptSourceModel.ScreenSize = SourceModel.ScreenSize;
+		}
+		StaticMesh->SetNumSourceModels(0);
+		StaticMesh->GetStaticMaterials().Empty();
+		StaticMesh->GetSectionInfoMap().Clear();
+		StaticMesh->GetOriginalSectionInfoMap().Clear();
+	}
+	else
+	{
+		StaticMesh = FPskPsaUtils::LocalCreate<UStaticMesh>(UStaticMesh::StaticClass(), Parent, Name.ToString(), Flags);
+	}
+	
+	TArray<FPskChunkHash> ChunkHashes;
+	for (auto LODIndex = 0; LODIndex < LODs.Num(); LODIndex++)
+	{
+		UPskAssetImportData::AppendLODChunkHashes(ChunkHashes, LODs[LODIndex].ChunkHashes, LODIndex);
+	}
+	const auto ImportData = UPskAssetImportData::Assign(StaticMesh, MeshData.Report.Filename, ChunkHashes);
+	{
+		PSK_IMPORT_STAGE(STAT_PskImport_Materials, Timings.Materials);
 
-			RawMesh.WedgeIndices.Add(PskWedge.PointIndex);
-			RawMesh.WedgeColors.Add(Data.bHasVertexColors ? VertexColorsByPoint[PskWedge.PointIndex] : FColor::Black);
-			RawMesh.WedgeTexCoords[0].Add(FVector2f(PskWedge.U, PskWedge.V));
-			for (auto UVIndex = 0; UVIndex < Data.ExtraUVs.Num(); UVIndex++)
+		// sections of every LOD point into one material list, LOD0 materials first
+		TArray<FString> MaterialNames;
+		for (auto LODIndex = 0; LODIndex < LODs.Num(); LODIndex++)
+		{
+			const auto& LODMaterialNames = LODs[LODIndex].MaterialNames;
+			for (auto SectionIndex = 0; SectionIndex < LODMaterialNames.Num(); SectionIndex++)
 			{
-				auto UV =  Data.ExtraUVs[UVIndex][PskFace.WedgeIndex[VertexIndex]];
-				RawMesh.WedgeTexCoords[UVIndex+1].Add(UV);
+				const auto MaterialIndex = MaterialNames.AddUnique(LODMaterialNames[SectionIndex]);
+				StaticMesh->GetSectionInfoMap().Set(LODIndex, SectionIndex, FMeshSectionInfo(MaterialIndex));
 			}
-			
-			RawMesh.WedgeTangentZ.Add(Data.bHasVertexNormals ? Data.Normals[PskWedge.PointIndex] * FVector3f(1, -1, 1) : FVector3f::ZeroVector);
-			RawMesh.WedgeTangentY.Add(FVector3f::ZeroVector);
-			RawMesh.WedgeTangentX.Add(FVector3f::ZeroVector);
 		}
+		
+		const auto Materials = MaterialResolver.Resolve(MaterialNames, Parent, Flags);
+		for (auto i = 0; i < Materials.Num(); i++)
+		{
+			const auto SlotName = FName(MaterialNames[i]);
+			StaticMesh->GetStaticMaterials().Add(FStaticMaterial(Materials[i], SlotName, SlotName));
+		}
+		ImportData->SetMaterials(MaterialNames, Materials);
 	}
-	
-	const auto StaticMesh = FPskPsaUtils::LocalCreate<UStaticMesh>(UStaticMesh::StaticClass(), Parent, Name.ToString(), Flags);
 
-	for (auto i = 0; i < Data.Materials.Num(); i++)
+	PSK_IMPORT_STAGE(STAT_PskImport_Build, Timings.Build);
+	
+	for (auto LODIndex = 0; LODIndex < LODs.Num(); LODIndex++)
 	{
-		auto PskMaterial = Data.Materials[i];
-		
-		UObject* MatParent;
-		auto FoundMaterialPath = MaterialNameToPathMap.Find(PskMaterial.MaterialName);
-		if (FoundMaterialPath != nullptr)
+		auto& SourceModel = StaticMesh->AddSourceModel();
+		if (KeptSourceModels.IsValidIndex(LODIndex))
 		{
-			MatParent = CreatePackage(**FoundMaterialPath);
+			SourceModel.BuildSettings = KeptSourceModels[LODIndex].BuildSettings;
+			SourceModel.ReductionSettings = KeptSourceModels[LODIndex].ReductionSettings;
+			SourceModel.ScreenSize = KeptSourceModels[LODIndex].ScreenSize;
 		}
 		else
 		{
-			MatParent = Parent;
+			SourceModel.BuildSettings.bGenerateLightmapUVs = false;
+			SourceModel.BuildSettings.bBuildReversedIndexBuffer = false;
+			SourceModel.BuildSettings.bRemoveDegenerates = true;
 		}
-		
-		auto MaterialAdd = FPskPsaUtils::LocalFindOrCreate<UMaterialInstanceConstant>(UMaterialInstanceConstant::StaticClass(), MatParent, PskMaterial.MaterialName, Flags);
-
-		StaticMesh->GetStaticMaterials().Add(FStaticMaterial(MaterialAdd));
-		StaticMesh->GetSectionInfoMap().Set(0, i, FMeshSectionInfo(i));
+		SourceModel.BuildSettings.bRecomputeNormals = !LODs[LODIndex].bHasVertexNormals;
+		SourceModel.BuildSettings.bRecomputeTangents = !LODs[LODIndex].bHasTangents;
+		SourceModel.BuildSettings.bUseMikkTSpace = true;
+		StaticMesh->CreateMeshDescription(LODIndex, MoveTemp(LODs[LODIndex].MeshDescription));
+		StaticMesh->CommitMeshDescription(LODIndex);
 	}
-	
-	auto& SourceModel = StaticMesh->AddSourceModel();
-	SourceModel.BuildSettings.bGenerateLightmapUVs = false;
-	SourceModel.BuildSettings.bBuildReversedIndexBuffer = false;
-	SourceModel.BuildSettings.bRemoveDegenerates = true;
-	SourceModel.BuildSettings.bRecomputeNormals = !Data.bHasVertexNormals;
-	SourceModel.BuildSettings.bRecomputeTangents = true;
-	SourceModel.BuildSettings.bUseMikkTSpace = true;
-	SourceModel.SaveRawMesh(RawMesh);
-
-	StaticMesh->Build();
-	StaticMesh->PostEditChange();
-	FAssetRegistryModule::AssetCreated(StaticMesh);
-	StaticMesh->MarkPackageDirty();
-	
-	FGlobalComponentReregisterContext RecreateComponents;
+
+	// builds every LOD in one pass, meshes of an open transaction are built together when it commits
+	FPskImportTransaction::BuildStaticMesh(StaticMesh);
+	FPskImportTransaction::AssetChanged(StaticMesh, ExistingMesh == nullptr);
+	FPskImportTransaction::ReregisterComponents();
 
 	return StaticMesh;
 }
@@ -2,19 +2,80 @@
 
 #include "UnrealPSKPSA.h"
 
+#include "ContentBrowserMenuContexts.h"
+#include "DesktopPlatformModule.h"
+#include "EditorDirectories.h"
+#include "IDesktopPlatform.h"
+#include "PskBatchExporter.h"
+#include "PskExporter.h"
+#include "ToolMenus.h"
+#include "Framework/Application/SlateApplication.h"
+
 #define LOCTEXT_NAMESPACE "FUnrealPSKPSAModule"
 
 DEFINE_LOG_CATEGORY(LogUnrealPSKPSA);
 
+static void ExportToActorX(const TArray<UObject*>& Assets)
+{
+	const auto DesktopPlatform = FDesktopPlatformModule::Get();
+	if (DesktopPlatform == nullptr) return;
+
+	FString Directory;
+	const auto ParentWindow = FSlateApplication::Get().FindBestParentWindowHandleForDialogs(nullptr);
+	if (!DesktopPlatform->OpenDirectoryDialog(ParentWindow, LOCTEXT("ExportToActorXTitle", "Export to ActorX").ToString(), FEditorDirectories::Get().GetLastDirectory(ELastDirectory::GENERIC_EXPORT), Directory)) return;
+
+	FEditorDirectories::Get().SetLastDirectory(ELastDirectory::GENERIC_EXPORT, Directory);
+	FPskBatchExporter::ExportToDirectory(Assets, Directory);
+}
+
 void FUnrealPSKPSAModule::StartupModule()
 {
-	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	UToolMenus::RegisterStartupCallback(FSimpleMulticastDelegate::FDelegate::CreateRaw(this, &FUnrealPSKPSAModule::RegisterMenus));
 }
 
 void FUnrealPSKPSAModule::ShutdownModule()
 {
-	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
-	// we call this function before unloading the module.
+	UToolMenus::UnRegisterStartupCallback(this);
+	UToolMenus::UnregisterOwner(this);
+}
+
+void FUnrealPSKPSAModule::RegisterMenus()
+{
+	FToolMenuOwnerScoped OwnerScoped(this);
+	
+	const auto Menu = UToolMenus::Get()->ExtendMenu("ContentBrowser.AssetContextMenu");
+	auto& Section = Menu->FindOrAddSection("GetAssetActions");
+	Section.AddDynamicEntry("ExportToActorX", FNewToolMenuSectionDelegate::CreateLambda([](FToolMenuSection& InSection)
+	{
+		const auto Context = InSection.FindContext<UContentBrowserAssetContextMenuContext>();
+		if (Context == nullptr) return;
+
+		// only shown when every selected asset can be exported
+		const auto SelectedObjects = Context->SelectedObjects;
+		if (SelectedObjects.IsEmpty()) return;
+		for (const auto& Object : SelectedObjects)
+		{
+			if (FPskExporter::GetExtension(Object.Get()).IsEmpty()) return;
+		}
+
+		InSection.AddMenuEntry(
+			"ExportToActorX",
+			LOCTEXT("ExportToActorX", "Export to ActorX..."),
+			LOCTEXT("ExportToActorXTooltip", "Exports the selected assets as .psk, .pskx or .psa files, in parallel"),
+			FSlateIcon(),
+			FUIAction(FExecuteAction::CreateLambda([SelectedObjects]
+			{
+				TArray<UObject*> Assets;
+				for (const auto& Object : SelectedObjects)
+				{
+					if (Object.IsValid())
+					{
+						Assets.Add(Object.Get());
+					}
+				}
+				ExportToActorX(Assets);
+			})));
+	}));
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -1,13 +1,5 @@
 ﻿#pragma once
 
-struct VChunkHeader
-{
-	char ChunkID[20];
-	int TypeFlag;
-	int DataSize;
-	int DataCount;
-};
-
 struct VVertex
 {
 	int PointIndex;
@@ -74,3 +66,32 @@ struct VMorphData
 	FVector3f TangentZDelta;
 	int PointIdx;
 };
+
+struct VAnimInfoBinary
+{
+	char Name[64];
+	char Group[64];
+	int TotalBones;
+	int RootInclude;
+	int KeyCompressionStyle;
+	int KeyQuotum;
+	float KeyReduction;
+	float TrackTime;
+	float AnimRate;
+	int StartBone;
+	int FirstRawFrame;
+	int NumRawFrames;
+};
+
+struct VQuatAnimKey
+{
+	FVector3f Position;
+	FQuat4f Orientation;
+	float Time;
+};
+
+struct VScaleAnimKey
+{
+	FVector3f ScaleVector;
+	float Time;
+};
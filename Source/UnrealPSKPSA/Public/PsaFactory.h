@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "PsaReader.h"
+#include "Factories/Factory.h"
+#include "PsaFactory.generated.h"
+
+/*
+ * Tracks are reduced before they reach the animation controller. Raw animation data holds either one key or a key per
+ * frame, so a track is only shortened when all of it is constant: it then keeps a single key, or none at all when that
+ * key is the reference pose of its bone.
+ */
+struct FPsaKeyReductionSettings
+{
+	bool bEnabled = true;
+	bool bRemoveReferencePoseTracks = true;
+	// largest distance in cm, angle in radians and scale difference a dropped key may be away from the kept one
+	float PositionTolerance = 0.001f;
+	float RotationTolerance = 0.0001f;
+	float ScaleTolerance = 0.0001f;
+};
+
+struct FPsaKeyReductionStats
+{
+	int64 KeysIn = 0;
+	int64 KeysOut = 0;
+	int32 Tracks = 0;
+	int32 ConstantTracks = 0;
+	int32 RemovedTracks = 0;
+
+	double GetRemovedRatio() const { return KeysIn > 0 ? 1.0 - static_cast<double>(KeysOut) / KeysIn : 0.0; }
+};
+
+UCLASS()
+class UNREALPSKPSA_API UPsaFactory : public UFactory
+{
+	GENERATED_BODY()
+public:
+	UPsaFactory()
+	{
+		bEditorImport = true;
+		bText = false;
+
+		Formats.Add(FactoryExtension + ";" + FactoryDescription);
+
+		SupportedClass = FactoryClass;
+	}
+	
+	static UObject* Import(const FString& Filename, UObject* Parent, const FName Name, const EObjectFlags Flags, USkeleton* Skeleton, const FPsaKeyReductionSettings& KeyReduction = FPsaKeyReductionSettings());
+	static USkeleton* FindSkeleton(const UObject* Parent, const FPsaReader& Data);
+
+protected:
+	UClass* FactoryClass = UAnimSequence::StaticClass();
+	FString FactoryExtension = "psa";
+	FString FactoryDescription = "Unreal Animation";
+
+	virtual bool FactoryCanImport(const FString& Filename) override
+	{
+		// only walks the chunk headers, no keys are decoded
+		const auto Extension = FPaths::GetExtension(Filename);
+		return Extension.Equals(FactoryExtension) && FPsaReader(Filename).bIsValid;
+	}
+	
+	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Params, FFeedbackContext* Warn, bool& bOutOperationCanceled) override
+	{
+		return Import(Filename, InParent, InName, Flags, nullptr);
+	}
+};
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include "PskReader.h"
+
+/*
+ * Reads a .psa file. Bone names and sequence infos are decoded when the file is opened, animation keys are never
+ * loaded as a whole: they are decoded straight out of the mapped ANIMKEYS chunk as each bone track is converted.
+ */
+class UNREALPSKPSA_API FPsaReader
+{
+public:
+	FPsaReader(const FString& Filepath);
+
+	FPsaReader(const FPsaReader&) = delete;
+	FPsaReader& operator=(const FPsaReader&) = delete;
+
+	bool bIsValid = false;
+	bool bHasScaleKeys = false;
+
+	TConstArrayView<VNamedBoneBinary> Bones;
+	TArray<VAnimInfoBinary> AnimInfos;
+
+	int64 GetFileSize() const { return File.GetSize(); }
+	int32 GetNumKeys() const { return KeysChunk ? KeysChunk->Header.Count : 0; }
+	VQuatAnimKey GetKey(int32 KeyIndex) const;
+	VScaleAnimKey GetScaleKey(int32 KeyIndex) const;
+
+	// keys are stored frame by frame, with every bone of the sequence on each frame
+	static int32 GetKeyIndex(const VAnimInfoBinary& Info, const int32 Frame, const int32 BoneIndex)
+	{
+		return static_cast<int32>(ActorX::GetAnimKeyIndex(Info.FirstRawFrame, Info.TotalBones, Frame, BoneIndex));
+	}
+
+	bool IsSequenceInBounds(const VAnimInfoBinary& Info) const;
+
+private:
+	FPskMappedFile File;
+	TArray<FPskChunk> Chunks;
+	const FPskChunk* KeysChunk = nullptr;
+	const FPskChunk* ScaleKeysChunk = nullptr;
+	
+	TArray<VNamedBoneBinary> BonesStorage;
+};
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "EditorFramework/AssetImportData.h"
+#include "PskAssetImportData.generated.h"
+
+struct FPskChunk;
+class UMaterialInterface;
+
+USTRUCT()
+struct FPskChunkHash
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FString ChunkName;
+
+	UPROPERTY()
+	uint64 Hash = 0;
+};
+
+enum class EPskReimportChange : uint8
+{
+	None,
+	MaterialsOnly,
+	Full
+};
+
+/*
+ * Import data of meshes created from .psk/.pskx files. Besides the source path it keeps a content hash of every chunk
+ * of the source file, which lets a reimport tell an untouched file and a material-only edit apart from a geometry change.
+ */
+UCLASS()
+class UNREALPSKPSA_API UPskAssetImportData : public UAssetImportData
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	TArray<FPskChunkHash> ChunkHashes;
+
+	// folder every material was resolved to, keyed by psk material name, so a reimport finds mapped materials again
+	UPROPERTY()
+	TMap<FString, FString> MaterialNameToPathMap;
+
+	EPskReimportChange Compare(const TArray<FPskChunkHash>& NewChunkHashes) const;
+
+	// hashes header and data of every chunk, chunks are hashed in parallel
+	static TArray<FPskChunkHash> HashChunks(const TArray<FPskChunk>& Chunks);
+	// one hash over the whole file, used as the derived data cache key of converted data
+	static uint64 GetContentHash(const TArray<FPskChunkHash>& ChunkHashes);
+	// chunks of lower LODs are stored under LODn/ names, so their edits never pass for material-only changes
+	static void AppendLODChunkHashes(TArray<FPskChunkHash>& ChunkHashes, const TArray<FPskChunkHash>& LODChunkHashes, const int32 LODIndex);
+
+	static UPskAssetImportData* Get(const UObject* Mesh);
+	// creates import data for a skeletal or static mesh and attaches it
+	static UPskAssetImportData* Assign(UObject* Mesh, const FString& Filename, const TArray<FPskChunkHash>& ChunkHashes);
+	void SetMaterials(const TArray<FString>& MaterialNames, const TArray<UMaterialInterface*>& Materials);
+};
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+struct FPskBatchExportTask
+{
+	UObject* Asset = nullptr;
+	FString Filename;
+};
+
+struct FPskBatchExportResult
+{
+	bool bSucceeded = false;
+	int64 BytesWritten = 0;
+	double Seconds = 0.0;
+};
+
+struct FPskBatchExportStats
+{
+	int32 NumAssets = 0;
+	int32 NumExported = 0;
+	int64 TotalBytes = 0;
+	double TotalSeconds = 0.0;
+
+	double GetAssetsPerSecond() const { return TotalSeconds > 0.0 ? NumExported / TotalSeconds : 0.0; }
+	double GetMegabytesPerSecond() const { return TotalSeconds > 0.0 ? TotalBytes / (1024.0 * 1024.0) / TotalSeconds : 0.0; }
+};
+
+/*
+ * Exports many assets at once. The game thread only loads source data, gathering chunks and writing files runs on
+ * task graph workers with every asset exported independently.
+ */
+class UNREALPSKPSA_API FPskBatchExporter
+{
+public:
+	// tasks writing a file an earlier task already writes fail instead of racing it
+	static TArray<FPskBatchExportResult> Export(const TArray<FPskBatchExportTask>& Tasks, FPskBatchExportStats* OutStats = nullptr);
+	// one file per asset, named after the asset with a _n suffix when another asset took the name. Assets that cannot be exported are skipped
+	static TArray<FPskBatchExportResult> ExportToDirectory(const TArray<UObject*>& Assets, const FString& Directory, FPskBatchExportStats* OutStats = nullptr);
+};
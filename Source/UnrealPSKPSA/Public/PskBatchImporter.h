@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "PskImportStats.h"
+
+struct FPskBatchImportTask
+{
+	FString Filename;
+	UObject* Parent = nullptr;
+	FName Name;
+};
+
+struct FPskBatchImportResult
+{
+	UObject* Asset = nullptr;
+	FPskImportReport Report;
+};
+
+struct FPskBatchImportStats
+{
+	int32 NumFiles = 0;
+	int32 NumImported = 0;
+	int64 TotalBytes = 0;
+	double TotalSeconds = 0.0;
+	// part of TotalSeconds spent building every static mesh of the batch together
+	double StaticMeshBuildSeconds = 0.0;
+
+	double GetFilesPerSecond() const { return TotalSeconds > 0.0 ? NumImported / TotalSeconds : 0.0; }
+	double GetMegabytesPerSecond() const { return TotalSeconds > 0.0 ? TotalBytes / (1024.0 * 1024.0) / TotalSeconds : 0.0; }
+};
+
+/*
+ * Imports many .psk/.pskx files at once. Reading and converting runs on task graph workers, a bounded number of
+ * files ahead of the game thread, which only creates and registers the resulting UObjects in task order. The whole batch
+ * runs in one FPskImportTransaction. A Name_LOD0 task imports its Name_LODn siblings as further LODs of the same mesh.
+ */
+class UNREALPSKPSA_API FPskBatchImporter
+{
+public:
+	static TArray<FPskBatchImportResult> Import(const TArray<FPskBatchImportTask>& Tasks, const TMap<FString, FString>& MaterialNameToPathMap, const EObjectFlags Flags, FPskBatchImportStats* OutStats = nullptr);
+};
@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimSequence.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+#include "Exporters/Exporter.h"
+#include "PskExporter.generated.h"
+
+/*
+ * Writes skeletal meshes as .psk, static meshes as .pskx and animation sequences as .psa, from the same source data the
+ * importers create: the imported LOD0 model, the LOD0 mesh description and the raw animation tracks. Each chunk is
+ * gathered into one array already in its on-disk layout and written in one block.
+ */
+class UNREALPSKPSA_API FPskExporter
+{
+public:
+	// "psk", "pskx" or "psa", empty for assets that cannot be exported
+	static FString GetExtension(const UObject* Asset);
+	
+	// game thread only, loads the source data and waits for async builds so Export can run on any thread afterwards
+	static bool Prepare(UObject* Asset);
+	static bool Export(const UObject* Asset, FArchive& Ar);
+	static bool ExportToFile(const UObject* Asset, const FString& Filename, int64* OutBytes = nullptr);
+};
+
+UCLASS()
+class UNREALPSKPSA_API UPskExporter : public UExporter
+{
+	GENERATED_BODY()
+public:
+	UPskExporter()
+	{
+		bText = false;
+		SupportedClass = USkeletalMesh::StaticClass();
+		FormatExtension.Add("psk");
+		FormatDescription.Add("Unreal Skeletal Mesh");
+	}
+
+	virtual bool ExportBinary(UObject* Object, const TCHAR* Type, FArchive& Ar, FFeedbackContext* Warn, int32 FileIndex = 0, uint32 PortFlags = 0) override
+	{
+		return FPskExporter::Prepare(Object) && FPskExporter::Export(Object, Ar);
+	}
+};
+
+UCLASS()
+class UNREALPSKPSA_API UPskxExporter : public UPskExporter
+{
+	GENERATED_BODY()
+public:
+	UPskxExporter()
+	{
+		SupportedClass = UStaticMesh::StaticClass();
+		FormatExtension = { "pskx" };
+		FormatDescription = { "Unreal Static Mesh" };
+	}
+};
+
+UCLASS()
+class UNREALPSKPSA_API UPsaExporter : public UPskExporter
+{
+	GENERATED_BODY()
+public:
+	UPsaExporter()
+	{
+		SupportedClass = UAnimSequence::StaticClass();
+		FormatExtension = { "psa" };
+		FormatDescription = { "Unreal Animation" };
+	}
+};
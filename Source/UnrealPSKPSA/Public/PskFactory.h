@@ -1,9 +1,14 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "PskReader.h"
 #include "Factories/Factory.h"
 #include "PskFactory.generated.h"
 
+struct FPskMeshImportData;
+struct FPskImportProgress;
+class FPskMaterialResolver;
+
 UCLASS()
 class UNREALPSKPSA_API UPskFactory : public UFactory
 {
@@ -19,8 +24,21 @@ public:
 		SupportedClass = FactoryClass;
 	}
 	
+	// ExistingMesh is rebuilt in place instead of creating a new mesh, keeping its skeleton and everything not read
+	// from the file (sockets, physics asset, LOD settings, ...). Reimports pass the mesh being reimported
 	static UObject* Import(const FString& Filename, UObject* Parent, const FName Name, const EObjectFlags Flags, TMap<FString, FString>
-	                       MaterialNameToPathMap);
+	                       MaterialNameToPathMap, USkeletalMesh* ExistingMesh = nullptr);
+
+	// reads and converts a file without touching any UObjects, safe to call from worker threads
+	static bool ReadMesh(const FString& Filename, FPskMeshImportData& OutMeshData, FPskImportProgress* Progress = nullptr);
+	// ReadMesh for a Name_LOD0 file and its Name_LODn siblings, which are read concurrently
+	static bool ReadMeshLODs(const FString& Filename, TArray<FPskMeshImportData>& OutLODs, FPskImportProgress* Progress = nullptr);
+	// creates the mesh and its skeleton from converted data, game thread only
+	static UObject* CreateMesh(FPskMeshImportData& MeshData, UObject* Parent, const FName Name, const EObjectFlags Flags, FPskMaterialResolver& MaterialResolver);
+	// one mesh with a LOD per entry, lower LODs have to be skinned to bones of LOD0
+	static UObject* CreateMesh(TArrayView<FPskMeshImportData> LODs, UObject* Parent, const FName Name, const EObjectFlags Flags, FPskMaterialResolver& MaterialResolver, USkeletalMesh* ExistingMesh = nullptr);
+	static void FinishReports(TArrayView<FPskMeshImportData> LODs, const UObject* Asset);
+	
 	static void ProcessSkeleton(const FSkeletalMeshImportData&    ImportData,
 								const USkeleton*                  Skeleton,
 								FReferenceSkeleton&               OutRefSkeleton,
@@ -33,13 +51,12 @@ protected:
 
 	virtual bool FactoryCanImport(const FString& Filename) override
 	{
+		// only walks the chunk headers, no chunk data is decoded
 		const auto Extension = FPaths::GetExtension(Filename);
-		return Extension.Equals(FactoryExtension);
+		return Extension.Equals(FactoryExtension) && FPskReader(Filename).bIsValid;
 	}
 	
-	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Params, FFeedbackContext* Warn, bool& bOutOperationCanceled) override
-	{
-		return Import(Filename, InParent, FName(*InName.ToString().Replace(TEXT("_LOD0"), TEXT(""))), Flags, TMap<FString, FString>());
-	}
+	// reads and converts on a background task behind a cancelable progress dialog, only creating the mesh blocks the editor
+	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Params, FFeedbackContext* Warn, bool& bOutOperationCanceled) override;
 	
 };
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PskImportCommandlet.generated.h"
+
+/*
+ * Imports .psk/.pskx files without the editor UI and saves the resulting packages.
+ *
+ * UnrealEditor-Cmd <Project> -run=PskImport -Source=<Directory|Manifest> -Destination=/Game/Meshes
+ *		[-MaterialMap=<Json>] [-Report=<Json>] [-Recursive] [-NoSave]
+ *
+ * A manifest is a text file with one file path per line. The material map is a json object of
+ * material name to material path. Every file is reported as one json line prefixed with "PskImport:"
+ * and the whole run is written as one json report, to Saved/PskImport unless -Report is given.
+ * The exit code is non-zero if any file failed.
+ */
+UCLASS()
+class UNREALPSKPSA_API UPskImportCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UPskImportCommandlet();
+	
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	static bool GatherFiles(const FString& Source, const bool bRecursive, TArray<FString>& OutFiles);
+	static bool LoadMaterialMap(const FString& Filename, TMap<FString, FString>& OutMaterialNameToPathMap);
+	static bool SavePackage(UPackage* Package, UObject* Asset);
+};
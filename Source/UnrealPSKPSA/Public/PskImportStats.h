@@ -0,0 +1,115 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/ScopedTimers.h"
+#include "Stats/Stats.h"
+
+class FJsonObject;
+
+DECLARE_STATS_GROUP(TEXT("PSK/PSA Import"), STATGROUP_PskImport, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Read"), STAT_PskImport_Read, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Convert"), STAT_PskImport_Convert, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Create"), STAT_PskImport_Create, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Materials"), STAT_PskImport_Materials, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Skeleton"), STAT_PskImport_Skeleton, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build"), STAT_PskImport_Build, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Morph Targets"), STAT_PskImport_MorphTargets, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Animation"), STAT_PskImport_Animation, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Save"), STAT_PskImport_Save, STATGROUP_PskImport, UNREALPSKPSA_API);
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes Read"), STAT_PskImport_BytesRead, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Files"), STAT_PskImport_Files, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Wedges"), STAT_PskImport_Wedges, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Faces"), STAT_PskImport_Faces, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Influences"), STAT_PskImport_Influences, STATGROUP_PskImport, UNREALPSKPSA_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Bones"), STAT_PskImport_Bones, STATGROUP_PskImport, UNREALPSKPSA_API);
+
+// an insights scope, a cycle stat and the report timing of one import stage, for the rest of the enclosing scope
+#define PSK_IMPORT_STAGE(Stat, Seconds) \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Stat); \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	FScopedDurationTimer PREPROCESSOR_JOIN(PskImportStageTimer, __LINE__)(Seconds)
+
+// wall clock seconds spent in each stage of importing one file
+struct FPskImportTimings
+{
+	double Read = 0.0;
+	double Convert = 0.0;
+	// everything on the game thread, Materials, Skeleton, Build and MorphTargets are parts of it
+	double Create = 0.0;
+	double Materials = 0.0;
+	double Skeleton = 0.0;
+	double Build = 0.0;
+	double MorphTargets = 0.0;
+	double Save = 0.0;
+
+	double GetTotal() const { return Read + Convert + Create + Save; }
+	void Accumulate(const FPskImportTimings& Other);
+};
+
+struct FPskImportCounters
+{
+	int64 BytesRead = 0;
+	int64 Points = 0;
+	int64 Wedges = 0;
+	int64 Faces = 0;
+	int64 Influences = 0;
+	int64 Bones = 0;
+	int64 Materials = 0;
+	int64 MorphTargets = 0;
+	int64 AnimKeys = 0;
+	// bone keys psa key reduction left out of the imported tracks
+	int64 AnimKeysRemoved = 0;
+	// influences normalization merged, dropped as negligible or cut off at psk.MaxBoneInfluences
+	int64 InfluencesRemoved = 0;
+
+	void Accumulate(const FPskImportCounters& Other);
+	// adds these counters to the running STAT accumulators
+	void UpdateStats() const;
+};
+
+/*
+ * Process memory an import used on top of what was in use when it started, sampled between stages. Whenever the
+ * process reached a new peak during the import that peak is used instead, which also catches peaks inside a stage.
+ * Imports running concurrently on other threads show up in each other's samples.
+ */
+struct UNREALPSKPSA_API FPskImportMemory
+{
+	int64 BaselineBytes = 0;
+	int64 BaselinePeakBytes = 0;
+	int64 PeakBytes = 0;
+	// size of the converted data handed to the mesh builder, the figure the peak is measured against
+	int64 ImportDataBytes = 0;
+
+	void Begin();
+	void Sample();
+	double GetPeakRatio() const { return ImportDataBytes > 0 ? static_cast<double>(PeakBytes) / ImportDataBytes : 0.0; }
+};
+
+/*
+ * What importing one file cost. Every import logs its report as one json line, batches aggregate them into one
+ * document that can be written next to the logs for build farm dashboards.
+ */
+struct UNREALPSKPSA_API FPskImportReport
+{
+	FString Filename;
+	FString AssetPath;
+	bool bSucceeded = false;
+	// converted data came from the derived data cache, convert timings are zero
+	bool bFromCache = false;
+	FPskImportTimings Timings;
+	FPskImportCounters Counters;
+	FPskImportMemory Memory;
+
+	// records the outcome and logs the report
+	void Finish(const UObject* Asset);
+	
+	TSharedRef<FJsonObject> ToJson() const;
+
+	static TSharedRef<FJsonObject> MakeBatchJson(const TArray<FPskImportReport>& Reports, const double WallSeconds, const bool bIncludeFiles);
+	static FString ToJsonString(const TSharedRef<FJsonObject>& Json, const bool bPretty = false);
+	static bool WriteBatchReport(const TArray<FPskImportReport>& Reports, const double WallSeconds, const FString& Filename);
+	static FString GetDefaultReportFilename();
+};
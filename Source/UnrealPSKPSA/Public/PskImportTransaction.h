@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+class UStaticMesh;
+
+/*
+ * Batches the editor notifications of many imports. While a transaction is open, PostEditChange, the asset registry
+ * notification and package dirtying of every asset are deferred and sent once per asset when it closes, and
+ * component reregistration is done once for the whole batch instead of once per mesh. Static mesh builds are deferred
+ * too and run together, spread over all cores, before any asset is finalized. Without an open transaction everything
+ * happens immediately. Transactions nest, only the outermost one commits.
+ */
+class UNREALPSKPSA_API FPskImportTransaction
+{
+public:
+	FPskImportTransaction();
+	~FPskImportTransaction();
+
+	FPskImportTransaction(const FPskImportTransaction&) = delete;
+	FPskImportTransaction& operator=(const FPskImportTransaction&) = delete;
+
+	// game thread only. bCreated also notifies the asset registry, it sticks once any call for the asset sets it
+	static void AssetChanged(UObject* Asset, const bool bCreated);
+	// reregisters every component in every world so they pick up rebuilt meshes
+	static void ReregisterComponents();
+	// builds every LOD of a static mesh whose mesh descriptions are committed
+	static void BuildStaticMesh(UStaticMesh* StaticMesh);
+
+	static bool IsActive() { return Active != nullptr; }
+	
+	// sends everything deferred so far, the transaction stays open
+	void Commit();
+
+	// wall clock time of the deferred static mesh builds of every commit so far, the meshes build concurrently
+	double GetStaticMeshBuildSeconds() const { return StaticMeshBuildSeconds; }
+	int32 GetNumStaticMeshesBuilt() const { return NumStaticMeshesBuilt; }
+
+private:
+	struct FPendingAsset
+	{
+		TWeakObjectPtr<UObject> Asset;
+		bool bCreated = false;
+	};
+
+	static void FinalizeAsset(UObject* Asset, const bool bCreated);
+	void BuildPendingStaticMeshes();
+	
+	TArray<TWeakObjectPtr<UStaticMesh>> PendingStaticMeshes;
+	TArray<FPendingAsset> PendingAssets;
+	TMap<FObjectKey, int32> PendingIndices;
+	int32 NumDeferredCalls = 0;
+	double StaticMeshBuildSeconds = 0.0;
+	int32 NumStaticMeshesBuilt = 0;
+	bool bReregisterComponents = false;
+	bool bIsOutermost = false;
+
+	static FPskImportTransaction* Active;
+};
@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+class UMaterialInterface;
+class UMaterialInstanceConstant;
+
+/*
+ * Resolves psk material names to material assets for the lifetime of an import session. Every distinct material is
+ * looked up once, existing ones through a single asset registry query per Resolve call, and missing ones are created
+ * right away but only finalized (PostEditChange, registry notification, dirtying) together in Flush.
+ */
+class UNREALPSKPSA_API FPskMaterialResolver
+{
+public:
+	FPskMaterialResolver(const TMap<FString, FString>& InMaterialNameToPathMap);
+	~FPskMaterialResolver();
+
+	FPskMaterialResolver(const FPskMaterialResolver&) = delete;
+	FPskMaterialResolver& operator=(const FPskMaterialResolver&) = delete;
+
+	// game thread only, materials not in MaterialNameToPathMap are placed next to Parent
+	TArray<UMaterialInterface*> Resolve(const TArray<FString>& MaterialNames, const UObject* Parent, const EObjectFlags Flags);
+	void Flush();
+
+private:
+	FString GetPackageName(const FString& MaterialName, const UObject* Parent) const;
+	
+	TMap<FString, FString> MaterialNameToPathMap;
+	TMap<FString, TWeakObjectPtr<UMaterialInterface>> MaterialsByPackage;
+	TArray<TWeakObjectPtr<UMaterialInstanceConstant>> PendingMaterials;
+};
@@ -1,5 +1,7 @@
 ﻿#pragma once
-#include "AssetRegistry/AssetRegistryModule.h"
+#include "EngineDefines.h"
+#include "PskImportTransaction.h"
+#include "Misc/PackageName.h"
 
 class FPskPsaUtils
 {
@@ -13,9 +15,7 @@ public:
 		if (!Asset)
 		{
 			Asset = NewObject<T>(Package, StaticClass, FName(Filename), Flags);
-			Asset->PostEditChange();
-			FAssetRegistryModule::AssetCreated(Asset);
-			Asset->MarkPackageDirty();
+			FPskImportTransaction::AssetChanged(Asset, true);
 		}
 		
 		return Asset;
@@ -29,4 +29,39 @@ public:
 		auto Asset = NewObject<T>(Package, StaticClass, FName(Filename), Flags);
 		return Asset;
 	}
+
+	// Filename, or Filename_n with the lowest n whose package is neither loaded nor on disk, so creating it replaces nothing
+	static FString MakeUniqueAssetName(UObject* FactoryParent, const FString& Filename)
+	{
+		const auto Folder = FPaths::GetPath(FactoryParent->GetPathName() + "/");
+		
+		auto Name = Filename;
+		for (auto Suffix = 1; ; Suffix++)
+		{
+			const auto PackageName = FPaths::Combine(Folder, Name);
+			if (FindPackage(nullptr, *PackageName) == nullptr && !FPackageName::DoesPackageExist(PackageName)) return Name;
+			
+			Name = FString::Printf(TEXT("%s_%d"), *Filename, Suffix);
+		}
+	}
+
+	// Filename followed by every consecutive Name_LODn sibling when Filename is a Name_LOD0 file, Filename alone otherwise
+	static TArray<FString> FindLODFilenames(const FString& Filename, const int32 MaxLODs = MAX_MESH_LOD_COUNT)
+	{
+		TArray<FString> Filenames = { Filename };
+		
+		const auto BaseFilename = FPaths::GetBaseFilename(Filename);
+		if (!BaseFilename.EndsWith(TEXT("_LOD0"))) return Filenames;
+
+		const auto Prefix = FPaths::Combine(FPaths::GetPath(Filename), BaseFilename.LeftChop(1));
+		const auto Extension = FPaths::GetExtension(Filename, true);
+		for (auto LODIndex = 1; LODIndex < MaxLODs; LODIndex++)
+		{
+			auto LODFilename = FString::Printf(TEXT("%s%d%s"), *Prefix, LODIndex, *Extension);
+			if (!FPaths::FileExists(LODFilename)) break;
+			
+			Filenames.Add(MoveTemp(LODFilename));
+		}
+		return Filenames;
+	}
 };
@@ -1,46 +1,176 @@
 ﻿#pragma once
-#include <fstream>
-
 #include "ActorXModels.h"
+#include "ActorXCore/ActorXReader.h"
+#include "HAL/CriticalSection.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// usable at compile time for decoder registration
+constexpr uint32 PskChunkHash(const ANSICHAR* ChunkID, const int32 MaxLength = 20)
+{
+	return ActorX::ChunkHash(ChunkID, MaxLength);
+}
 
 class FPskHeader
 {
 public:
-	FString ChunkName;
+	ANSICHAR ChunkName[21];
+	uint32 ChunkHash;
 	int Size;
 	int Count;
 	
-	FPskHeader(std::ifstream& Ar)
+	FPskHeader(const ActorX::ChunkHeader& Header)
 	{
-		VChunkHeader Header;
-		Ar.read(reinterpret_cast<char*>(&Header), sizeof(VChunkHeader));
-
-		ChunkName = FString(UTF8_TO_TCHAR(Header.ChunkID));
+		FMemory::Memcpy(ChunkName, Header.ChunkID, sizeof Header.ChunkID);
+		ChunkName[sizeof Header.ChunkID] = '\0';
+		ChunkHash = ActorX::ChunkHash(Header.ChunkID);
 		Size = Header.DataSize;
 		Count = Header.DataCount;
 	}
+
+	int64 GetDataSize() const
+	{
+		return static_cast<int64>(Size) * Count;
+	}
+};
+
+enum class EPskChunk : uint8
+{
+	Points,
+	Wedges,
+	Faces,
+	Materials,
+	Normals,
+	Tangents,
+	VertexColors,
+	ExtraUVs,
+	Bones,
+	Influences,
+	MorphInfos,
+	MorphDatas,
+	Unknown
+};
+
+struct FPskChunk
+{
+	FPskHeader Header;
+	const uint8* Data;
+	EPskChunk Type = EPskChunk::Unknown;
+	bool bLoaded = false;
+};
+
+/*
+ * A memory mapped ActorX file (falling back to one bulk read where mapping is unsupported) and the directory of
+ * chunks that follow its main header. Shared by the psk and psa readers.
+ */
+class UNREALPSKPSA_API FPskMappedFile
+{
+public:
+	~FPskMappedFile();
+	
+	bool Open(const FString& Filepath);
+	bool ReadChunkDirectory(const ANSICHAR* MainChunkName, TArray<FPskChunk>& OutChunks) const;
+
+	const uint8* GetData() const { return FileData; }
+	int64 GetSize() const { return FileSize; }
+
+private:
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray64<uint8> FileBuffer;
+	
+	const uint8* FileData = nullptr;
+	int64 FileSize = 0;
 };
 
+/*
+ * Reads a .psk/.pskx file by memory mapping it and exposing every chunk as a view over the mapped bytes.
+ * Opening a file only walks the chunk headers to build a directory, chunks are decoded the first time they are
+ * requested. Chunks whose on-disk layout differs from the in-memory struct (16-bit faces, packed bones, ...) are
+ * unpacked into storage owned by the reader, so the views are only valid for as long as the reader is alive.
+ */
 class UNREALPSKPSA_API FPskReader
 {
 public:
 	FPskReader(const FString& Filepath);
+
+	FPskReader(const FPskReader&) = delete;
+	FPskReader& operator=(const FPskReader&) = delete;
 	
 	bool bIsValid = false;
-	bool bHasVertexNormals = false;
-	bool bHasVertexColors = false;
-	bool bHasMorphData = false;
+
+	int64 GetFileSize() const { return File.GetSize(); }
+	const TArray<FPskChunk>& GetChunks() const { return Chunks; }
+	const FPskChunk* FindChunk(EPskChunk Type) const;
+	int32 GetCount(EPskChunk Type) const;
 	
-	TArray<FVector3f> Vertices;
-	TArray<VVertex> Wedges;
-	TArray<VTriangle> Faces;
-	TArray<VMaterial> Materials;
-	TArray<FVector3f> Normals;
-	TArray<FColor> VertexColors;
-	TArray<TArray<FVector2f>> ExtraUVs;
-	TArray<VMorphInfo> MorphInfos;
-	TArray<VMorphData> MorphDatas;
-
-	TArray<VNamedBoneBinary> Bones;
-	TArray<VRawBoneInfluence> Influences;
-};
\ No newline at end of file
+	TConstArrayView<FVector3f> GetVertices() { LoadChunks(EPskChunk::Points); return Vertices; }
+	TConstArrayView<VVertex> GetWedges() { LoadChunks(EPskChunk::Wedges); return Wedges; }
+	TConstArrayView<VTriangle> GetFaces() { LoadChunks(EPskChunk::Faces); return Faces; }
+	TConstArrayView<VMaterial> GetMaterials() { LoadChunks(EPskChunk::Materials); return Materials; }
+	TConstArrayView<FVector3f> GetNormals() { LoadChunks(EPskChunk::Normals); return Normals; }
+	// xyz is the tangent, w the sign the bitangent cross(normal, tangent) is scaled by
+	TConstArrayView<FVector4f> GetTangents() { LoadChunks(EPskChunk::Tangents); return Tangents; }
+	TConstArrayView<FColor> GetVertexColors() { LoadChunks(EPskChunk::VertexColors); return VertexColors; }
+	const TArray<TConstArrayView<FVector2f>>& GetExtraUVs() { LoadChunks(EPskChunk::ExtraUVs); return ExtraUVs; }
+	TConstArrayView<VMorphInfo> GetMorphInfos() { LoadChunks(EPskChunk::MorphInfos); return MorphInfos; }
+	TConstArrayView<VMorphData> GetMorphDatas() { LoadChunks(EPskChunk::MorphDatas); return MorphDatas; }
+	TConstArrayView<VNamedBoneBinary> GetBones() { LoadChunks(EPskChunk::Bones); return Bones; }
+	TConstArrayView<VRawBoneInfluence> GetInfluences() { LoadChunks(EPskChunk::Influences); return Influences; }
+
+	// decode the chunks they ask about, chunks that were dropped while decoding count as missing
+	bool HasVertexNormals() { return !GetNormals().IsEmpty(); }
+	bool HasVertexTangents() { return !GetTangents().IsEmpty(); }
+	bool HasVertexColors() { return !GetVertexColors().IsEmpty(); }
+	bool HasMorphData() { return !GetMorphInfos().IsEmpty() && !GetMorphDatas().IsEmpty(); }
+
+	// REFSKELT and the psa BONENAMES chunk share the same packed layout
+	static TConstArrayView<VNamedBoneBinary> UnpackBones(const FPskChunk& Chunk, TArray<VNamedBoneBinary>& Storage);
+
+private:
+	struct FChunkDecoder
+	{
+		EPskChunk Type;
+		void (*Decode)(FPskReader& Reader, const FPskChunk& Chunk);
+	};
+	static const TMap<uint32, FChunkDecoder>& GetChunkDecoders();
+	static void DecodeBones(FPskReader& Reader, const FPskChunk& Chunk);
+	static void DecodeInfluences(FPskReader& Reader, const FPskChunk& Chunk);
+	
+	void LoadChunks(EPskChunk Type);
+
+	template <typename T>
+	static TConstArrayView<T> ViewChunk(const FPskChunk& Chunk, TArray<T>& FallbackStorage);
+
+	FPskMappedFile File;
+	TArray<FPskChunk> Chunks;
+	FCriticalSection LoadLock;
+	
+	TConstArrayView<FVector3f> Vertices;
+	TConstArrayView<VVertex> Wedges;
+	TConstArrayView<VTriangle> Faces;
+	TConstArrayView<VMaterial> Materials;
+	TConstArrayView<FVector3f> Normals;
+	TConstArrayView<FVector4f> Tangents;
+	TConstArrayView<FColor> VertexColors;
+	TArray<TConstArrayView<FVector2f>> ExtraUVs;
+	TConstArrayView<VMorphInfo> MorphInfos;
+	TConstArrayView<VMorphData> MorphDatas;
+	TConstArrayView<VNamedBoneBinary> Bones;
+	TConstArrayView<VRawBoneInfluence> Influences;
+
+	// backing storage for chunks that could not be viewed in place
+	TArray<FVector3f> VerticesStorage;
+	TArray<VVertex> WedgesStorage;
+	TArray<VTriangle> FacesStorage;
+	TArray<VMaterial> MaterialsStorage;
+	TArray<FVector3f> NormalsStorage;
+	TArray<FVector4f> TangentsStorage;
+	TArray<FColor> VertexColorsStorage;
+	TArray<TArray<FVector2f>> ExtraUVsStorage;
+	TArray<VMorphInfo> MorphInfosStorage;
+	TArray<VMorphData> MorphDatasStorage;
+	TArray<VNamedBoneBinary> BonesStorage;
+	TArray<VRawBoneInfluence> InfluencesStorage;
+};
@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "EditorReimportHandler.h"
+#include "Factories/Factory.h"
+#include "PskReimportFactory.generated.h"
+
+/*
+ * Reimports skeletal and static meshes created from .psk/.pskx files. The source file is only hashed chunk by chunk
+ * and compared against the hashes stored at import: an unchanged file is skipped, a file whose only change is its
+ * material list has its materials reassigned without rebuilding geometry, anything else is imported again in place.
+ */
+UCLASS()
+class UNREALPSKPSA_API UPskReimportFactory : public UFactory, public FReimportHandler
+{
+	GENERATED_BODY()
+public:
+	UPskReimportFactory()
+	{
+		bEditorImport = false;
+		bText = false;
+	}
+
+	virtual bool CanReimport(UObject* Obj, TArray<FString>& OutFilenames) override;
+	virtual void SetReimportPaths(UObject* Obj, const TArray<FString>& NewReimportPaths) override;
+	virtual EReimportResult::Type Reimport(UObject* Obj) override;
+	virtual int32 GetPriority() const override { return ImportPriority; }
+};
@@ -14,4 +14,8 @@ public:
 	/** IModuleInterface implementation */
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
+
+private:
+	// adds Export to ActorX to the content browser asset context menu
+	void RegisterMenus();
 };
@@ -26,6 +26,7 @@ public class UnrealPSKPSA : ModuleRules
 			new string[]
 			{
 				"Core",
+				"ActorXCore",
 				// ... add other public dependencies that you statically link with here ...
 			}
 			);
@@ -42,13 +43,18 @@ public class UnrealPSKPSA : ModuleRules
 				"UnrealEd",
 				"Projects",
 				"MeshDescription",
+				"StaticMeshDescription",
 				"ToolWidgets",
 
-				"RawMesh",
 				"RenderCore",
 				"MeshBuilder",
 				"MeshUtilitiesCommon", 
 				"EditorScriptingUtilities",
+				"Json",
+				"DerivedDataCache",
+				"ToolMenus",
+				"ContentBrowser",
+				"DesktopPlatform",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);